@@ -11,13 +11,15 @@
 
 #include "dmk_base.h"
 #include "dmk_xmlutil.h"
+#include "dmk_sink.h"
 #include <map>
 
 namespace DMK {
 
 //----------------------------------------------------------------------------
-
-
+// Maps output file names to the sinks that write to them - there is one
+// sink per file, shared by all generators writing to it.
+//----------------------------------------------------------------------------
 
 class FileManager {
 
@@ -29,15 +31,16 @@ class FileManager {
 		static FileManager & Instance();
 
 		void Clear();
+		void Flush();
 
 		std::string HideName() const;
 		std::string StdOutName() const;
 
-		std::ostream & GetStream( const std::string & fname );
+		OutputSink & GetSink( const std::string & fname );
 
 	private:
 
-		typedef std::map <std::string, std::ostream *> NameMapType;
+		typedef std::map <std::string, OutputSink *> NameMapType;
 		NameMapType mNameMap;
 		std::ostream & mDefOut;
 		static FileManager * mInstance;
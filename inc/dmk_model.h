@@ -59,6 +59,8 @@ class Echoer : public ModelEntry {
 // sources. Generators must have a name, so they can ber eferred to later.
 //
 // Note that Generator is ABSTRACT - it is fully implemented by the gen tag.
+// Generated rows are kept for RowAt(), unless the generator is seekable,
+// when they are made again from the sources as they are needed.
 //----------------------------------------------------------------------------
 
 class Generator : public  ModelEntry {
@@ -86,12 +88,16 @@ class Generator : public  ModelEntry {
 
 		virtual int GetSize();
 		void AddRow( const Row & row );
+		bool Seekable() const;
+		void SetSeekRows( int n );
 		virtual Row Get();
+		virtual void GetBatch( Rows & rows, unsigned int n );
 		virtual void DebugRow( const Row & row, std::ostream & os );
 
 		bool Debug() const;
 
 		bool HasGroup() const;
+		const FieldList & Group() const;
 		void DoGroup();
 
 	private:
@@ -101,6 +107,7 @@ class Generator : public  ModelEntry {
 		std::vector <class DataSource *> mSources;
 		Rows mRows;
 		FieldList mGroup;
+		int mSeekRows;				// row count if seekable, else -1
 
 };
 
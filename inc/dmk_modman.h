@@ -12,6 +12,7 @@
 #include "dmk_base.h"
 #include "dmk_model.h"
 #include "a_xmltree.h"
+#include <set>
 
 namespace DMK {
 
@@ -32,6 +33,10 @@ class ModelManager {
 		Model * FindModel( const std::string & name ) const;
 		Generator * FindGen( const std::string & name ) const;
 
+		void AddGenRef( const std::string & name );
+		bool IsGenRef( const std::string & model,
+							const std::string & gen ) const;
+
 		void RunModels( std::ostream & os );
 
 		static ModelManager * Instance();
@@ -39,6 +44,9 @@ class ModelManager {
 		int CommandLineCount() const;
 		int & CommandLineCount();
 
+		int CommandLineThreads() const;
+		int & CommandLineThreads();
+
 	private:
 
 		ModelManager();
@@ -57,7 +65,9 @@ class ModelManager {
 		};
 
 		std::vector <MME> mModels;
+		std::set <std::string> mGenRefs;	// as "model.gen"
 		int mCmdLineCount;
+		int mCmdLineThreads;
 
 };
 
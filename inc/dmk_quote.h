@@ -0,0 +1,27 @@
+//---------------------------------------------------------------------------
+// dmk_quote.h
+//
+// Escaping of text for CSV output
+//
+// Copyright (C) 2009 Neil Butterworth
+//---------------------------------------------------------------------------
+
+#ifndef INC_DMK_QUOTE_H
+#define INC_DMK_QUOTE_H
+
+namespace DMK {
+
+//----------------------------------------------------------------------------
+// Copy len bytes of text to out, doubling any double quotes, and return the
+// end of the output. The output must have room for 2 * len bytes. Uses
+// SSE2 or AVX2 where the processor supports them.
+//----------------------------------------------------------------------------
+
+char * CSVEscape( char * out, const char * text, unsigned int len );
+
+//----------------------------------------------------------------------------
+
+} // namespace
+
+#endif
+
@@ -9,11 +9,62 @@
 #ifndef INC_DMK_RANDOM_H
 #define INC_DMK_RANDOM_H
 
+#include <string>
+#include <vector>
 
 namespace DMK {
 
 //----------------------------------------------------------------------------
-// Integer random number generator
+// Counter-based random number stream. The n'th value of a stream depends
+// only on the stream's key and on n - it is the Philox4x32-10 function of
+// Salmon et al applied to n - so streams with different keys are
+// independent, and any position can be reached in constant time. Each
+// stream is further divided into 2^64 substreams of 2^66 values each.
+// operator(), min() and max() are kept for callers that want a uniform
+// random number generator.
+//----------------------------------------------------------------------------
+
+class RandomStream {
+
+	public:
+
+		typedef unsigned int result_type;
+
+		RandomStream( unsigned long long key = 0 );
+
+		void SetKey( unsigned long long key );
+		unsigned long long Key() const;
+
+		void Substream( unsigned long long n );
+		void Seek( unsigned long long pos );
+		unsigned long long Tell() const;
+
+		result_type operator()();
+		void Fill( result_type * out, unsigned int n );
+		result_type min() const;
+		result_type max() const;
+
+		int Random();
+		int Random( int begin, int end );
+		unsigned int Below( unsigned int n );
+		unsigned long long Below64( unsigned long long n );
+		void FillBelow( unsigned int n, unsigned int * out, unsigned int count );
+		double Real();
+
+		static void Block( const unsigned int ctr[4], const unsigned int key[2],
+								unsigned int out[4] );
+
+	private:
+
+		unsigned long long mKey, mSub, mPos;
+		bool mFilled;
+		unsigned int mBlock[4];
+};
+
+//----------------------------------------------------------------------------
+// Global random number generator. Data sources don't use this directly but
+// each have their own stream, with a key made by StreamKey() from the seed
+// and a name for the source.
 //----------------------------------------------------------------------------
 
 class RNG {
@@ -22,7 +73,9 @@ class RNG {
 		static void Randomise();
 		static int Random( int begin, int end );
 		static int Random();
+		static unsigned int Below( unsigned int n );
 		static int GetSeed();
+		static unsigned long long StreamKey( const std::string & id );
 
 	private:
 		static int mLastSeed;
@@ -30,17 +83,120 @@ class RNG {
 };
 
 //----------------------------------------------------------------------------
-// Base for distribution classes
+// Walker's alias method - picks index i with probability proportional to
+// weight i in constant time, however many weights there are. Tables are
+// built in linear time using Vose's method.
+//----------------------------------------------------------------------------
+
+class AliasTable {
+
+	public:
+
+		AliasTable();
+		AliasTable( const std::vector <double> & weights );
+
+		void Build( const std::vector <double> & weights );
+		unsigned int Size() const;
+		unsigned int Pick( RandomStream & rs ) const;
+		unsigned int Pick( double u ) const;
+
+	private:
+
+		std::vector <double> mProb;
+		std::vector <unsigned int> mAlias;
+};
+
+//----------------------------------------------------------------------------
+// Keyed pseudo-random permutation of [0,n), so things can be shuffled
+// without being stored. An index is split into two halves of h bits and
+// put through a Feistel network, which is a bijection on [0,2^2h) however
+// its rounds mix - results of n or more are sent round again until they
+// fall in range (cycle walking), keeping it a bijection on [0,n). As 2^2h
+// is less than 4n, At() takes under four passes on average.
+//----------------------------------------------------------------------------
+
+class Permutation {
+
+	public:
+
+		Permutation( unsigned long long n = 1, unsigned long long key = 0 );
+
+		unsigned long long Size() const;
+		unsigned long long At( unsigned long long i ) const;
+
+	private:
+
+		enum { ROUNDS = 4 };
+
+		unsigned long long Encrypt( unsigned long long x ) const;
+
+		unsigned long long mSize, mMask;
+		unsigned int mBits;
+		unsigned long long mKeys[ ROUNDS ];
+};
+
+//----------------------------------------------------------------------------
+// Strings made by picking one character from each of a list of character
+// sets, none of them repeated. The n'th string is a permuted counter
+// written in mixed radix, each set's size being one digit's base, so no
+// strings need remembering. If there are more than 2^64 possible strings,
+// only the trailing sets are counted through and the leading ones are
+// picked at random, which keeps the strings different.
+//----------------------------------------------------------------------------
+
+class UniqueStrings {
+
+	public:
+
+		UniqueStrings( const std::vector <std::string> & charsets
+							= std::vector <std::string>() );
+
+		unsigned long long Size() const;
+		std::string Next( RandomStream & rs );
+
+	private:
+
+		std::vector <std::string> mSets;
+		unsigned int mFirst;				// first set counted through
+		unsigned long long mSize, mCount;
+		Permutation mPerm;
+};
+
+//----------------------------------------------------------------------------
+// Base for distribution classes. Values are made in bulk by FillReal() -
+// single values are just a fill of one, so drawing a value at a time or in
+// batches gives the same sequence. Distributions that may reject values
+// use Word() and Unit(), which take stream values from a pool in order,
+// so the sequence stays the same for them too.
 //----------------------------------------------------------------------------
 
 class Distribution {
 
 	public:
 
+		Distribution( RandomStream & rs );
 		virtual ~Distribution();
-		virtual double NextReal() = 0;
-		virtual int NextInt() = 0;
 
+		double NextReal();
+		int NextInt();
+
+		virtual void FillReal( double * out, unsigned int n ) = 0;
+		void FillInt( int * out, unsigned int n );
+
+	protected:
+
+		void FillUnit( double * out, unsigned int n,
+							double offset = 0.0, double scale = 1.0 );
+		unsigned int Word();
+		double Unit();
+
+	private:
+
+		RandomStream & mStream;
+		std::vector <unsigned int> mBits;
+		std::vector <double> mReals;
+		std::vector <unsigned int> mPool;
+		unsigned int mPoolPos;
 };
 
 //----------------------------------------------------------------------------
@@ -51,15 +207,14 @@ class TriangleDist : public Distribution {
 
 	public:
 
-		TriangleDist( double begin, double mode, double end );
-		~TriangleDist();
+		TriangleDist( RandomStream & rs,
+						double begin, double mode, double end );
 
-		double NextReal();
-		int NextInt();
+		void FillReal( double * out, unsigned int n );
 
 	private:
 
-		struct TDImpl * mImpl;
+		double mBegin, mMode, mEnd;
 };
 
 //----------------------------------------------------------------------------
@@ -70,17 +225,124 @@ class UniformDist : public Distribution {
 
 	public:
 
-		UniformDist( double begin, double end );
-		~UniformDist();
+		UniformDist( RandomStream & rs, double begin, double end );
 
-		double NextReal();
-		int NextInt();
+		void FillReal( double * out, unsigned int n );
+
+	private:
+
+		double mBegin, mEnd;
+};
+
+//----------------------------------------------------------------------------
+// Zipf distribution over ranks 1 to n, rank k having weight 1 / k^s. Uses
+// rejection-inversion sampling, so needs no per-rank table and works for
+// any n up to 2^53. A value can take more than one uniform to make, so
+// uniforms are drawn in bulk into a pool and used in order, which keeps
+// the sequence the same however the values are asked for.
+//----------------------------------------------------------------------------
+
+class ZipfDist : public Distribution {
+
+	public:
+
+		ZipfDist( RandomStream & rs, double n, double s );
+
+		void FillReal( double * out, unsigned int n );
+
+	private:
+
+		double H( double x ) const;
+		double HIntegral( double x ) const;
+		double HIntegralInverse( double x ) const;
+
+		double mN, mS;
+		double mHX1, mHN, mCut;
+};
+
+//----------------------------------------------------------------------------
+// Normal distribution, by the ziggurat method of Marsaglia & Tsang - nearly
+// all values take one table lookup and a multiply. Log-normal values are
+// exp() of normal ones, so mean and sd are those of the log.
+//----------------------------------------------------------------------------
+
+class NormalDist : public Distribution {
+
+	public:
+
+		NormalDist( RandomStream & rs, double mean, double sd,
+						bool lognormal = false );
+
+		void FillReal( double * out, unsigned int n );
+
+	private:
+
+		double mMean, mSD;
+		bool mLog;
+};
+
+//----------------------------------------------------------------------------
+// Exponential distribution, also by ziggurat
+//----------------------------------------------------------------------------
+
+class ExponentialDist : public Distribution {
+
+	public:
+
+		ExponentialDist( RandomStream & rs, double mean );
+
+		void FillReal( double * out, unsigned int n );
+
+	private:
+
+		double mMean;
+};
+
+//----------------------------------------------------------------------------
+// Poisson distribution. Values beyond 12 standard deviations of the mean
+// have too little chance to matter, so the rest are put in an alias table
+// and each value needs just one uniform.
+//----------------------------------------------------------------------------
+
+class PoissonDist : public Distribution {
+
+	public:
+
+		PoissonDist( RandomStream & rs, double mean );
+
+		void FillReal( double * out, unsigned int n );
 
 	private:
 
-		struct UDImpl * mImpl;
+		double mLow;
+		AliasTable mTable;
 };
 
+//----------------------------------------------------------------------------
+// Names a distribution and its parameters, so a data source can make it
+// once it has a stream to give it. The parameters are checked when the
+// spec is created. An empty spec means the tag's own uniform or
+// triangular distribution.
+//----------------------------------------------------------------------------
+
+class DistSpec {
+
+	public:
+
+		DistSpec();
+		DistSpec( const std::string & name, double mean, double sd );
+
+		bool Empty() const;
+		Distribution * Make( RandomStream & rs ) const;
+
+		static bool ValidName( const std::string & name );
+		static bool HasSD( const std::string & name );
+
+	private:
+
+		std::string mName;
+		double mMean, mSD;
+};
 
 //----------------------------------------------------------------------------
 
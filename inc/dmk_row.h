@@ -15,9 +15,46 @@
 
 namespace DMK {
 
+//----------------------------------------------------------------------------
+// Types of value a row field can hold. Non-text values are stored in
+// native form and only turned into text when the row is output or a
+// field is accessed as a string.
+//----------------------------------------------------------------------------
+
+enum CellType {
+	CELL_TEXT = 0,
+	CELL_INT,			// 64-bit integer
+	CELL_REAL,			// double, with number of decimal places
+	CELL_DATE,			// packed as yyyymmdd
+	CELL_TIME			// seconds since midnight
+};
+
+//----------------------------------------------------------------------------
+// Header of the flat storage used by a row. It is followed in memory by
+// mFieldCap + 1 field end offsets, mFieldCap field type bytes and then
+// mByteCap bytes of field data, so all of a row's values live in a single
+// block.
+//----------------------------------------------------------------------------
+
+struct RowBlock {
+	unsigned int mFields, mFieldCap, mBytes, mByteCap;
+};
+
 //----------------------------------------------------------------------------
 // A row is the basic DMK data structure, passed around between data sources
-// and filters. As it is copied a lot, we make it reference counted.
+// and filters. Short rows are stored inline in the row object itself; longer
+// ones in a single heap block which, as rows are copied a lot, is
+// reference counted.
+//
+// Rows built with AppendRef() don't copy the appended rows but refer to
+// them as segments. Flatten() turns such a row back into a single block,
+// and should be used before a row is stored for a long time.
+//
+// Fields may be typed (see CellType) - for these Data() and Length() give
+// the native value, and At() the formatted text.
+//
+// WriteBinary() and ReadBinary() save and restore a row, types included,
+// in a compact form used when rows are spilled to temporary files.
 //----------------------------------------------------------------------------
 
 class Row {
@@ -35,21 +72,60 @@ class Row {
 		unsigned int Size() const;
 		bool IsEmpty() const;
 
-		const std::string & operator[] ( unsigned int  i ) const;
-		const std::string & At( unsigned int  i ) const;
+		std::string operator[] ( unsigned int  i ) const;
+		std::string At( unsigned int  i ) const;
+
+		const char * Data( unsigned int i ) const;
+		unsigned int Length( unsigned int i ) const;
+		CellType Type( unsigned int i ) const;
+		unsigned int Places( unsigned int i ) const;
 
 		Row & AppendValue( const std::string & val );
+		Row & AppendValue( const char * data, unsigned int len );
+		Row & AppendInt( long long n );
+		Row & AppendReal( double d, unsigned int places );
+		Row & AppendDate( int year, int month, int day );
+		Row & AppendTime( int secs );
+		Row & AppendField( const Row & row, unsigned int i );
 		Row & AppendCSV( const std::string & csv );
 		Row & AppendRow( const Row & row );
+		Row & AppendRef( const Row & row );
 		Row & AppendStrings( const Strings & cl );
 
 		std::string AsCSV() const;
+		unsigned int CSVSize() const;
+		char * WriteCSV( char * p ) const;
+
+		unsigned int BinarySize() const;
+		char * WriteBinary( char * p ) const;
+		const char * ReadBinary( const char * p );
 
 		void Erase( unsigned int col );
+		void Reserve( unsigned int fields, unsigned int bytes );
+		void Flatten();
 
 	private:
 
-		mutable class RowRep * mRep;
+		enum { INLINE_SIZE = 88 };
+
+		RowBlock * Block() const;
+		unsigned int Space() const;
+		unsigned int ByteCount() const;
+		void Release();
+		unsigned char TypeByte( unsigned int i ) const;
+		Row & AppendCell( const char * data, unsigned int len,
+								unsigned char type );
+
+		bool Segmented() const;
+		bool Unique() const;
+		const Row & Part( unsigned int & i ) const;
+		struct RowParts * Segments();
+
+		mutable class RowRep * mRep;		// null if stored inline
+		union {
+			RowBlock mHead;
+			char mInline[ INLINE_SIZE ];
+		};
 		static int mInstCount;
 };
 
@@ -69,6 +145,14 @@ bool operator == ( const Row & r1, const Row & r2 );
 bool operator != ( const Row & r1, const Row & r2 );
 int Cmp( const Row & r1, const Row & r2, const class FieldList & fl );
 
+//----------------------------------------------------------------------------
+// 64-bit hash of a row consistent with Cmp - rows that compare equal on
+// the field list always hash the same. Fields match when their formatted
+// text does, so text "7" matches int 7, but 9 and 9.00 don't match.
+//----------------------------------------------------------------------------
+
+unsigned long long Hash( const Row & r, const class FieldList & fl );
+
 //----------------------------------------------------------------------------
 // Stream output for debug only.
 //----------------------------------------------------------------------------
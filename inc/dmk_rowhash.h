@@ -0,0 +1,68 @@
+//---------------------------------------------------------------------------
+// dmk_rowhash.h
+//
+// Hashed set of rows, for finding duplicates
+//
+// Copyright (C) 2009 Neil Butterworth
+//---------------------------------------------------------------------------
+
+#ifndef INC_DMK_ROWHASH_H
+#define INC_DMK_ROWHASH_H
+
+#include "dmk_base.h"
+#include "dmk_row.h"
+#include "dmk_fieldlist.h"
+
+namespace DMK {
+
+//----------------------------------------------------------------------------
+// Set of rows compared on a list of fields (all fields if it is empty).
+// Normally only the 64-bit Hash() of each row is kept, in an open
+// addressing table, so two different rows are taken to be the same if
+// their hashes collide - for n rows the chance of this is about n * n /
+// 2^65. If verify is set the rows are kept as well, and rows with equal
+// hashes are compared with Cmp, so the set is exact.
+//
+// A set built from a row vector indexes rows the caller keeps, rather
+// than keeping its own copies. It is always exact, and each row inserted
+// must then be appended to the vector.
+//----------------------------------------------------------------------------
+
+class RowHashSet {
+
+	CANNOT_COPY( RowHashSet );
+
+	public:
+
+		RowHashSet( const FieldList & fields = FieldList(),
+						bool verify = false );
+		RowHashSet( const Rows & rows,
+						const FieldList & fields = FieldList() );
+
+		bool Insert( const Row & row );
+		bool Contains( const Row & row ) const;
+
+		unsigned int Size() const;
+		void Clear();
+
+	private:
+
+		unsigned long long RowHash( const Row & row ) const;
+		unsigned int Find( const Row & row, unsigned long long h ) const;
+		void Grow();
+
+		FieldList mFields;
+		bool mVerify;
+		std::vector <unsigned long long> mSlots;	// hashes, zero if empty
+		std::vector <unsigned int> mIndex;			// row in each slot if verify
+		Rows mRows;
+		const Rows * mStore;					// mRows, or the caller's rows
+		unsigned int mSize;
+};
+
+//----------------------------------------------------------------------------
+
+} // namespace
+
+#endif
+
@@ -32,6 +32,7 @@ class DMKRun {
 
 		void SeedRNG();
 		void SetCmdLineCount();
+		void SetCmdLineThreads();
 
 		ALib::CommandLine mCmdLine;
 		ALib::XMLTreeParser mParser;
@@ -0,0 +1,175 @@
+//---------------------------------------------------------------------------
+// dmk_sink.h
+//
+// Output sinks - where generated rows get written to
+//
+// Copyright (C) 2009 Neil Butterworth
+//---------------------------------------------------------------------------
+
+#ifndef INC_DMK_SINK_H
+#define INC_DMK_SINK_H
+
+#include "dmk_base.h"
+#include "dmk_row.h"
+#include <deque>
+#include <pthread.h>
+
+namespace DMK {
+
+//----------------------------------------------------------------------------
+// Base for all sinks. Rows are serialised as CSV straight into a buffer
+// that is reused for the life of the sink, and is only handed on to the
+// derived class when it is full or the sink is flushed.
+//----------------------------------------------------------------------------
+
+class OutputSink {
+
+	CANNOT_COPY( OutputSink );
+
+	public:
+
+		enum { BUFFER_SIZE = 256 * 1024 };
+
+		OutputSink( unsigned int bufsize = BUFFER_SIZE );
+		virtual ~OutputSink();
+
+		void Write( const Row & row );
+		void Write( const std::string & text );
+		void Write( const char * data, unsigned int n );
+		void Flush();
+
+	protected:
+
+		virtual void WriteOut( const char * data, unsigned int n ) = 0;
+
+	private:
+
+		char * Space( unsigned int n );
+
+		std::vector <char> mBuf;
+		unsigned int mPos;
+};
+
+//----------------------------------------------------------------------------
+// Sink writing to a file descriptor with write(2). Files opened by name
+// are closed by the sink; descriptors passed in (such as stdout) are not.
+//----------------------------------------------------------------------------
+
+class FileSink : public OutputSink {
+
+	public:
+
+		FileSink( const std::string & fname );
+		FileSink( int fd, const std::string & name );
+		~FileSink();
+
+	protected:
+
+		void WriteOut( const char * data, unsigned int n );
+
+	private:
+
+		int mFd;
+		bool mOwnFd;
+		std::string mName;
+};
+
+//----------------------------------------------------------------------------
+// Sink writing to a stream - for use when DMK is embedded and output
+// must go to a caller-supplied stream.
+//----------------------------------------------------------------------------
+
+class StreamSink : public OutputSink {
+
+	public:
+
+		StreamSink( std::ostream & os );
+		~StreamSink();
+
+	protected:
+
+		void WriteOut( const char * data, unsigned int n );
+
+	private:
+
+		std::ostream & mOut;
+};
+
+//----------------------------------------------------------------------------
+// Sink that throws everything away
+//----------------------------------------------------------------------------
+
+class NullSink : public OutputSink {
+
+	public:
+
+		NullSink();
+
+	protected:
+
+		void WriteOut( const char * data, unsigned int n );
+};
+
+//----------------------------------------------------------------------------
+// Makes row i of a range of rows. Used by worker threads, so MakeRow() must
+// be safe to call from several threads at once.
+//----------------------------------------------------------------------------
+
+class RowMaker {
+
+	public:
+
+		virtual ~RowMaker() {}
+		virtual void MakeRow( Row & row, unsigned long long i ) const = 0;
+};
+
+//----------------------------------------------------------------------------
+// Formats batches of rows as CSV on worker threads, and writes the text to
+// a sink in the order the batches were given to it, so the output is the
+// same as writing the rows one at a time. The workers only read the rows -
+// the batch the caller gets back from Write() has already been written and
+// is theirs to reuse. Rows that can be made by index are given as a range
+// and a RowMaker instead, and are then made by the workers as well.
+// Finish() must be called to write the last batches.
+//----------------------------------------------------------------------------
+
+class ParallelWriter {
+
+	CANNOT_COPY( ParallelWriter );
+
+	public:
+
+		ParallelWriter( OutputSink & out, unsigned int nthreads );
+		~ParallelWriter();
+
+		void Write( Rows & batch, unsigned int n );
+		void Write( const RowMaker & maker, unsigned long long first,
+						unsigned int n );
+		void Finish();
+
+	private:
+
+		struct Job;
+
+		static void * Work( void * p );
+		static void Format( Job * job );
+		void Collect( Job * job );
+		void Queue( Job * job );
+		void Stop();
+
+		OutputSink & mOut;
+		std::vector <Job *> mJobs;		// ring of jobs, reused in order
+		unsigned int mNext;				// next job in ring to use
+		std::deque <Job *> mQueue;		// jobs waiting for a worker
+		std::vector <pthread_t> mThreads;
+		pthread_mutex_t mLock;
+		pthread_cond_t mWork, mDone;
+		bool mStop;
+};
+
+//----------------------------------------------------------------------------
+
+} // namespace
+
+#endif
+
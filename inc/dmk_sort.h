@@ -0,0 +1,67 @@
+//---------------------------------------------------------------------------
+// dmk_sort.h
+//
+// Sorting of rows that may not fit in memory
+//
+// Copyright (C) 2009 Neil Butterworth
+//---------------------------------------------------------------------------
+
+#ifndef INC_DMK_SORT_H
+#define INC_DMK_SORT_H
+
+#include "dmk_base.h"
+#include "dmk_row.h"
+#include "dmk_fieldlist.h"
+
+namespace DMK {
+
+//----------------------------------------------------------------------------
+// Stable sort of rows on a list of fields. Rows are held in memory until
+// they take up more than the budget (in bytes), when they are sorted and
+// spilled to a temporary file as a run. Sort() is called once all rows
+// have been added, after which Next() gets the rows back in order, merging
+// the runs if there are any. Rows that compare equal come back in the
+// order they were added, so the result is the same whatever the budget.
+//----------------------------------------------------------------------------
+
+class RowSorter {
+
+	CANNOT_COPY( RowSorter );
+
+	public:
+
+		RowSorter( const FieldList & fields, unsigned int budget );
+		~RowSorter();
+
+		void Add( const Row & row );
+		void Sort();
+		bool Next( Row & row );
+
+		unsigned int Runs() const;
+
+	private:
+
+		struct Run;
+		struct RunOrder;
+
+		void Spill();
+		void MergeRuns();
+		void StartMerge( unsigned int first );
+		bool NextMerged( Row & row );
+
+		FieldList mFields;
+		unsigned int mBudget, mUsed;
+		Rows mRows;
+		unsigned int mPos;				// next row to return if no runs
+		std::vector <Run *> mRuns;
+		std::vector <unsigned int> mLevels;	// how often each run was merged
+		std::vector <unsigned int> mHeap;	// runs not yet exhausted
+		std::vector <char> mBuf;
+};
+
+//----------------------------------------------------------------------------
+
+} // namespace
+
+#endif
+
@@ -4,6 +4,7 @@
 // Base classes for all data sources These are:
 //
 //	- DataSource
+//	- LeafSource
 //	- CompositeDataSource
 //
 // Copyright (C) 2009 Neil Butterworth
@@ -15,6 +16,7 @@
 #include "dmk_base.h"
 #include "dmk_row.h"
 #include "dmk_fieldlist.h"
+#include "dmk_random.h"
 
 namespace DMK {
 
@@ -31,24 +33,75 @@ class DataSource : public RowSource {
 		DataSource( const FieldList & order = FieldList() );
 
 		virtual Row Get() = 0;
+		virtual void Emit( Row & row );
+		virtual void EmitBatch( Rows & rows, unsigned int n );
 		virtual int Size() = 0;
 		virtual void Reset() = 0;
 		virtual void Discard();
 
-		Row Last() const;
+		void GetBatch( Rows & rows, unsigned int n );
+		bool Ordered() const;
 
 	protected:
 
-		Row SaveLast( const Row & row ) const;
 		Row Order( const Row & row ) const;
+		RandomStream & Rand() const;
 
 	private:
 
 		FieldList mOrder;
-		mutable Row mLast;
+		mutable RandomStream mRand;
 
 };
 
+//----------------------------------------------------------------------------
+// Each source's random stream is keyed from a path naming where it is in
+// the model, so editing one part of a model doesn't change the random
+// values produced by another. A scope is active while the generator or
+// source for an XML element is created - sources made outside any scope
+// are just numbered in order of creation.
+//----------------------------------------------------------------------------
+
+class SourceScope {
+
+	CANNOT_COPY( SourceScope );
+
+	public:
+
+		SourceScope( const std::string & name );
+		~SourceScope();
+
+		static std::string ElementName( const ALib::XMLElement * e );
+		static std::string NextPath();
+
+	private:
+
+		struct Frame;
+		static std::vector <Frame> & Frames();
+};
+
+//----------------------------------------------------------------------------
+// Base for sources that make their own values rather than combining rows
+// from child sources. These write cells straight into the row being built
+// by the caller - Get() and Emit() are both implemented via EmitCells().
+//----------------------------------------------------------------------------
+
+class LeafSource : public DataSource {
+
+	public:
+
+		LeafSource( const FieldList & order = FieldList() );
+
+		Row Get();
+		void Emit( Row & row );
+		void EmitBatch( Rows & rows, unsigned int n );
+
+	protected:
+
+		virtual void EmitCells( Row & row ) = 0;
+		virtual void EmitCellBatch( Rows & rows, unsigned int n );
+};
+
 //----------------------------------------------------------------------------
 // Utility class
 //----------------------------------------------------------------------------
@@ -94,9 +147,15 @@ class CompositeDataSource : public DataSource{
 
 		virtual void AddChildSources( const ALib::XMLElement * e );
 
+	protected:
+
+		void EmitChildren( Row & row );
+		void EmitChildBatch( Rows & rows, unsigned int n );
+
 	private:
 
 		std::vector <DataSource *> mSources;
+		Rows mBatch;
 };
 
 //----------------------------------------------------------------------------
@@ -112,6 +171,7 @@ class Intermediate : public CompositeDataSource {
 		~Intermediate();
 
 		Row Get();
+		void Emit( Row & row );
 		int Size();
 		void Discard();
 
@@ -124,6 +184,7 @@ class Intermediate : public CompositeDataSource {
 
 	private:
 
+		const Row & Next();
 		void SafePopulate();
 
 		Rows mRows;
@@ -41,6 +41,10 @@ const char * const MIN_ATTRIB		= "min";
 const char * const MAX_ATTRIB		= "max";
 const char * const VALUE_ATTRIB	= "value";
 const char * const OUT_ATTRIB		= "output";
+const char * const FREQ_ATTRIB		= "freq";
+const char * const DIST_ATTRIB		= "dist";
+const char * const MEAN_ATTRIB		= "mean";
+const char * const SD_ATTRIB		= "sd";
 
 
 //----------------------------------------------------------------------------
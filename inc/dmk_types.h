@@ -20,7 +20,50 @@ bool IsType( const DataSource * s ) {
 	return dynamic_cast <const T *>(s) != 0;
 }
 
-struct SequenceType {};
+//----------------------------------------------------------------------------
+// Seekable sources can make the value they emit i'th directly, without
+// emitting the ones before it, so their rows can be made again later
+// rather than stored. Once a source has emitted a value, EmitAt() must
+// change nothing, so that rows can be made on several threads at once.
+//----------------------------------------------------------------------------
+
+struct SeekableType {
+	virtual ~SeekableType() {}
+	virtual bool Seekable() const {
+		return true;
+	}
+	virtual void EmitAt( Row & row, unsigned long long i ) = 0;
+};
+
+inline SeekableType * AsSeekable( DataSource * s ) {
+	SeekableType * sk = dynamic_cast <SeekableType *>( s );
+	return sk && sk->Seekable() ? sk : 0;
+}
+
+//----------------------------------------------------------------------------
+// Sequences are seekable sources whose values repeat in a cycle Size()
+// values long, all different - so things like shuffle can address them by
+// index rather than storing their rows. Sources that are only sometimes
+// indexable say so with Indexable(). Values that are different may still
+// format the same, in which case DistinctText() says so.
+//----------------------------------------------------------------------------
+
+struct SequenceType : public SeekableType {
+	virtual bool Indexable() const {
+		return true;
+	}
+	virtual bool DistinctText() const {
+		return true;
+	}
+	bool Seekable() const {
+		return Indexable();
+	}
+};
+
+inline SequenceType * AsSequence( DataSource * s ) {
+	SequenceType * seq = dynamic_cast <SequenceType *>( s );
+	return seq && seq->Indexable() ? seq : 0;
+}
 
 //----------------------------------------------------------------------------
 
@@ -17,6 +17,8 @@
 
 namespace DMK {
 
+class DistSpec;
+
 //----------------------------------------------------------------------------
 // Exception class used by folowing functions
 //----------------------------------------------------------------------------
@@ -72,6 +74,8 @@ bool GetBool( const ALib::XMLElement * e, const std::string & attr,
 							const std::string & def = "" );
 bool GetRandom( const ALib::XMLElement * e, const std::string & defval = "" );
 
+DistSpec GetDistSpec( const ALib::XMLElement * e );
+
 int GetCount( const ALib::XMLElement * e );
 
 std::string GetOutputFile( const ALib::XMLElement * e );
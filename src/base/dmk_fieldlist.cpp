@@ -92,7 +92,7 @@ Row FieldList :: OrderRow( const Row & r, const string & emptyval  ) const {
 		for ( unsigned int i = 0; i < mFields.size(); i++ ) {
 			unsigned int idx = mFields[i];
 			if ( idx <= r.Size() ) {
-				tmp.AppendValue( r.At( idx ) );
+				tmp.AppendField( r, idx );
 			}
 			else {
 				tmp.AppendValue( emptyval );
@@ -2,7 +2,7 @@
 // dmk_fileman.cpp
 //
 // File stream management. FileManger provides mapping of file names to
-// actual stream objects.
+// the output sinks that write to them.
 //
 // Copyright (C) 2009 Neil Butterworth
 //---------------------------------------------------------------------------
@@ -10,8 +10,7 @@
 
 #include "dmk_fileman.h"
 #include "a_base.h"
-#include "a_nullstream.h"
-#include <fstream>
+#include <iostream>
 
 using std::string;
 using std::vector;
@@ -33,7 +32,8 @@ FileManager & FileManager :: Instance() {
 
 //----------------------------------------------------------------------------
 // Create specifying default output stream, which will normally be stdout
-// but can be changed via command line options.
+// but can be changed via command line options. Output to stdout bypasses
+// the stream and is written directly to the file descriptor.
 //----------------------------------------------------------------------------
 
 FileManager :: FileManager( std::ostream & defout ) : mDefOut( defout ) {
@@ -53,7 +53,19 @@ FileManager :: ~FileManager() {
 }
 
 //----------------------------------------------------------------------------
-// Remove filename mappings
+// Write out anything the sinks are holding
+//----------------------------------------------------------------------------
+
+void FileManager :: Flush() {
+	NameMapType::iterator it = mNameMap.begin();
+	while( it != mNameMap.end() ) {
+		it->second->Flush();
+		++it;
+	}
+}
+
+//----------------------------------------------------------------------------
+// Remove filename mappings. Sinks flush themselves when deleted.
 //----------------------------------------------------------------------------
 
 void FileManager :: Clear() {
@@ -82,32 +94,33 @@ string FileManager :: StdOutName() const {
 }
 
 //----------------------------------------------------------------------------
-// Givena filename, get the associated stream, possibly creating it, in
-// which case add it to the ma.
+// Givena filename, get the associated sink, possibly creating it, in
+// which case add it to the map.
 //----------------------------------------------------------------------------
 
-std::ostream & FileManager :: GetStream( const string & fname ) {
+OutputSink & FileManager :: GetSink( const string & fname ) {
 	NameMapType::const_iterator it = mNameMap.find( fname );
 	if ( it != mNameMap.end() ) {
 		return * it->second;
 	}
-	else if ( fname == HideName() ) {
-		std::ostream * os = new ALib::NullStream;
-		mNameMap.insert( std::make_pair( fname, os ));
-		return * os;
+	OutputSink * sink;
+	if ( fname == HideName() ) {
+		sink = new NullSink;
 	}
 	else if ( fname == StdOutName() ) {
-		return mDefOut;
+		if ( &mDefOut == &std::cout ) {
+			mDefOut.flush();
+			sink = new FileSink( 1, "standard output" );
+		}
+		else {
+			sink = new StreamSink( mDefOut );
+		}
 	}
 	else {
-		std::ofstream * ofs = new std::ofstream( fname.c_str() );
-		if ( ! ofs->is_open() ) {
-			delete ofs;
-			throw Exception( "Cannot open output file " + fname );
-		}
-		mNameMap.insert( std::make_pair( fname, ofs ));
-		return * ofs;
+		sink = new FileSink( fname );
 	}
+	mNameMap.insert( std::make_pair( fname, sink ));
+	return * sink;
 }
 
 
@@ -14,6 +14,8 @@
 #include "dmk_tagdict.h"
 #include "dmk_xmlutil.h"
 #include "dmk_strings.h"
+#include "dmk_fileman.h"
+#include "dmk_types.h"
 #include <memory>
 #include <algorithm>
 
@@ -47,7 +49,8 @@ Echoer :: ~Echoer() {
 }
 
 void Echoer :: Generate( class Model * model ) {
-	model->DefaultOutput() << mText << std::endl;
+	FileManager & fm = FileManager::Instance();
+	fm.GetSink( fm.StdOutName() ).Write( mText + "\n" );
 }
 
 void Echoer :: Discard() {
@@ -58,7 +61,7 @@ void Echoer :: Discard() {
 //----------------------------------------------------------------------------
 
 Generator :: Generator( const string & name, bool debug, const FieldList & grp )
-	: mName( name ), mDebug( debug ), mGroup( grp ) {
+	: mName( name ), mDebug( debug ), mGroup( grp ), mSeekRows( -1 ) {
 }
 
 //----------------------------------------------------------------------------
@@ -79,7 +82,9 @@ string Generator :: Name() const {
 }
 
 //----------------------------------------------------------------------------
-// Handle grouping of output.
+// Handle grouping of output. The sort is stable, so rows in a group keep
+// the order they were generated in, as they do when the group is sorted
+// by RowSorter.
 //----------------------------------------------------------------------------
 
 struct Grouper {
@@ -96,12 +101,16 @@ bool Generator :: HasGroup() const {
 	return mGroup.Size() > 0;
 }
 
+const FieldList & Generator :: Group() const {
+	return mGroup;
+}
+
 void  Generator :: DoGroup()  {
 	if ( mGroup.Size() == 0 ) {
 		throw Exception( "No group specified" );
 	}
 	Grouper g( mGroup );
-	std::sort( mRows.begin(), mRows.end(), g );
+	std::stable_sort( mRows.begin(), mRows.end(), g );
 }
 
 //----------------------------------------------------------------------------
@@ -109,11 +118,44 @@ void  Generator :: DoGroup()  {
 //----------------------------------------------------------------------------
 
 int Generator :: Size() const {
-	return mRows.size();
+	return mSeekRows < 0 ? mRows.size() : mSeekRows;
 }
 
 Row Generator :: RowAt( int i ) const {
-	return mRows.at( i );
+	if ( mSeekRows < 0 ) {
+		return mRows.at( i );
+	}
+	if ( i < 0 || i >= mSeekRows ) {
+		throw Exception( "Invalid row index" );
+	}
+	Row r;
+	for ( unsigned int j = 0; j < SourceCount(); j++ ) {
+		AsSeekable( SourceAt( j ) )->EmitAt( r, i );
+	}
+	return r;
+}
+
+//----------------------------------------------------------------------------
+// Can row i be made again by having each source emit its i'th value? The
+// sources' values are emitted in order, so they can't be re-ordered, and
+// grouping would move the rows.
+//----------------------------------------------------------------------------
+
+bool Generator :: Seekable() const {
+	if ( HasGroup() || SourceCount() == 0 ) {
+		return false;
+	}
+	for ( unsigned int i = 0; i < SourceCount(); i++ ) {
+		if ( SourceAt( i )->Ordered() || AsSeekable( SourceAt( i ) ) == 0 ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// called instead of keeping the n rows generated
+void Generator :: SetSeekRows( int n ) {
+	mSeekRows = n;
 }
 
 
@@ -152,17 +194,29 @@ void Generator :: AddSources( const ALib::XMLElement * e ) {
 }
 
 //----------------------------------------------------------------------------
-// get single row by concating rows from sources
+// get single row by having each source append its values to it
 //----------------------------------------------------------------------------
 
 Row Generator :: Get() {
 	Row r;
 	for ( unsigned int i = 0; i < SourceCount(); i++ ) {
-		r.AppendRow( SourceAt( i )->Get() );
+		SourceAt( i )->Emit( r );
 	}
 	return r;
 }
 
+//----------------------------------------------------------------------------
+// get n rows at once by having each source in turn append a batch of
+// values to them
+//----------------------------------------------------------------------------
+
+void Generator :: GetBatch( Rows & rows, unsigned int n ) {
+	rows.assign( n, Row() );
+	for ( unsigned int i = 0; i < SourceCount(); i++ ) {
+		SourceAt( i )->EmitBatch( rows, n );
+	}
+}
+
 //----------------------------------------------------------------------------
 // Work out the number of rows to produce if the user doesn't specify
 // to do this we recursively send a "size" message to all kids
@@ -191,11 +245,13 @@ void Generator :: Discard() {
 }
 
 //----------------------------------------------------------------------------
-// Add row, checking for unique name done in builder
+// Add row, checking for unique name done in builder. Stored rows are kept
+// flat, as they may be used many times.
 //----------------------------------------------------------------------------
 
 void Generator :: AddRow( const Row & row )  {
 	mRows.push_back( row );
+	mRows.back().Flatten();
 }
 
 //----------------------------------------------------------------------------
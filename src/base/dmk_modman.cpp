@@ -31,7 +31,7 @@ const int MAX_INC 				= 50;
 // only needed so we can make it private
 //----------------------------------------------------------------------------
 
-ModelManager :: ModelManager() {
+ModelManager :: ModelManager() : mCmdLineCount( -1 ), mCmdLineThreads( 1 ) {
 }
 
 //----------------------------------------------------------------------------
@@ -136,6 +136,7 @@ void ModelManager :: Clear() {
 		delete mModels[i].mModel;
 	}
 	mModels.clear();
+	mGenRefs.clear();
 }
 
 //----------------------------------------------------------------------------
@@ -175,6 +176,29 @@ Generator * ModelManager :: FindGen( const std::string & name ) const {
 	return gp;
 }
 
+//----------------------------------------------------------------------------
+// Tags that look generators up by name when the model runs register the
+// name when they are built. Only generators registered this way need to
+// keep their rows - the rest can just write them out. Names are stored in
+// "model.gen" form, as the name may or may not give the model.
+//----------------------------------------------------------------------------
+
+void ModelManager :: AddGenRef( const std::string & name ) {
+	std::vector <string> tmp;
+	int n = ALib::Split( name,  NAMESEP_CHAR, tmp );
+	if ( n == 1 ) {
+		mGenRefs.insert( NAMESEP_CHAR + tmp[0] );
+	}
+	else {
+		mGenRefs.insert( name );	// if invalid, FindGen() will say so
+	}
+}
+
+bool ModelManager :: IsGenRef( const string & model,
+								const string & gen ) const {
+	return mGenRefs.find( model + NAMESEP_CHAR + gen ) != mGenRefs.end();
+}
+
 //----------------------------------------------------------------------------
 // Run models giving them stream as default output
 //----------------------------------------------------------------------------
@@ -199,6 +223,18 @@ int & ModelManager :: CommandLineCount() {
 	return mCmdLineCount;
 }
 
+//----------------------------------------------------------------------------
+// Access default number of threads per generator specified on command line
+//----------------------------------------------------------------------------
+
+int ModelManager :: CommandLineThreads() const {
+	return mCmdLineThreads;
+}
+
+int & ModelManager :: CommandLineThreads() {
+	return mCmdLineThreads;
+}
+
 //----------------------------------------------------------------------------
 // single model manager instance
 //----------------------------------------------------------------------------
@@ -224,6 +260,18 @@ using namespace DMK;
 
 DEFSUITE( "ModMan" );
 
+DEFTEST( GenRef ) {
+	ModelManager * mm = ModelManager::Instance();
+	mm->AddGenRef( "foo" );
+	mm->AddGenRef( "m.bar" );
+	FAILNE( mm->IsGenRef( "", "foo" ), true );
+	FAILNE( mm->IsGenRef( "m", "bar" ), true );
+	FAILNE( mm->IsGenRef( "m", "foo" ), false );
+	FAILNE( mm->IsGenRef( "", "bar" ), false );
+	mm->Clear();
+	FAILNE( mm->IsGenRef( "", "foo" ), false );
+}
+
 
 #endif
 
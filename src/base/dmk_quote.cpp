@@ -0,0 +1,194 @@
+//---------------------------------------------------------------------------
+// dmk_quote.cpp
+//
+// CSV escaping. Text fields are scanned for quotes a vector at a time, and
+// runs without quotes copied with a single store. The vector version to
+// use is picked at run-time, falling back to plain memchr/memcpy where
+// there is no SIMD support.
+//
+// Copyright (C) 2009 Neil Butterworth
+//---------------------------------------------------------------------------
+
+#include "dmk_quote.h"
+#include <cstring>
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define DMK_SIMD_QUOTE
+#include <immintrin.h>
+#endif
+
+namespace DMK {
+
+//----------------------------------------------------------------------------
+
+typedef char * (* EscapeFunc)( char *, const char *, unsigned int );
+
+//----------------------------------------------------------------------------
+// Scalar version, also used for the tails of the vector versions
+//----------------------------------------------------------------------------
+
+static char * EscapeScalar( char * out, const char * s, unsigned int len ) {
+	const char * end = s + len;
+	while( const char * q = (const char *) std::memchr( s, '"', end - s ) ) {
+		std::memcpy( out, s, q - s + 1 );
+		out += q - s + 1;
+		*out++ = '"';
+		s = q + 1;
+	}
+	std::memcpy( out, s, end - s );
+	return out + (end - s);
+}
+
+#ifdef DMK_SIMD_QUOTE
+
+//----------------------------------------------------------------------------
+// The vector versions store a whole block even if it contains a quote, then
+// back up to just after the quote and add the second one. This never
+// writes beyond 2 * len bytes as at least a block of input remains. The
+// AVX2 version clears the upper register halves before handing its tail
+// to SSE2 code, as mixing the two is very slow on some chips.
+//----------------------------------------------------------------------------
+
+__attribute__(( target( "sse2" ) ))
+static char * EscapeSSE2( char * out, const char * s, unsigned int len ) {
+	const char * end = s + len;
+	const __m128i quote = _mm_set1_epi8( '"' );
+	while( end - s >= 16 ) {
+		__m128i v = _mm_loadu_si128( (const __m128i *) s );
+		_mm_storeu_si128( (__m128i *) out, v );
+		unsigned int mask = _mm_movemask_epi8( _mm_cmpeq_epi8( v, quote ) );
+		if ( mask == 0 ) {
+			out += 16;
+			s += 16;
+		}
+		else {
+			unsigned int n = __builtin_ctz( mask ) + 1;
+			out += n;
+			*out++ = '"';
+			s += n;
+		}
+	}
+	return EscapeScalar( out, s, end - s );
+}
+
+__attribute__(( target( "avx2" ) ))
+static char * EscapeAVX2( char * out, const char * s, unsigned int len ) {
+	const char * end = s + len;
+	const __m256i quote = _mm256_set1_epi8( '"' );
+	while( end - s >= 32 ) {
+		__m256i v = _mm256_loadu_si256( (const __m256i *) s );
+		_mm256_storeu_si256( (__m256i *) out, v );
+		unsigned int mask = _mm256_movemask_epi8( _mm256_cmpeq_epi8( v, quote ) );
+		if ( mask == 0 ) {
+			out += 32;
+			s += 32;
+		}
+		else {
+			unsigned int n = __builtin_ctz( mask ) + 1;
+			out += n;
+			*out++ = '"';
+			s += n;
+		}
+	}
+	_mm256_zeroupper();
+	return EscapeSSE2( out, s, end - s );
+}
+
+#endif
+
+//----------------------------------------------------------------------------
+// Pick the best version for this processor
+//----------------------------------------------------------------------------
+
+static EscapeFunc ChooseEscape() {
+#ifdef DMK_SIMD_QUOTE
+	__builtin_cpu_init();
+	if ( __builtin_cpu_supports( "avx2" ) ) {
+		return EscapeAVX2;
+	}
+	if ( __builtin_cpu_supports( "sse2" ) ) {
+		return EscapeSSE2;
+	}
+#endif
+	return EscapeScalar;
+}
+
+//----------------------------------------------------------------------------
+// Short fields are not worth a call through the pointer
+//----------------------------------------------------------------------------
+
+char * CSVEscape( char * out, const char * text, unsigned int len ) {
+	static const EscapeFunc escape = ChooseEscape();
+	if ( len < 16 ) {
+		return EscapeScalar( out, text, len );
+	}
+	return escape( out, text, len );
+}
+
+//----------------------------------------------------------------------------
+
+} // namespace
+
+//----------------------------------------------------------------------------
+// Testing
+//----------------------------------------------------------------------------
+
+#ifdef DMK_TEST
+
+#include "a_myth.h"
+#include <string>
+#include <vector>
+using namespace ALib;
+using namespace DMK;
+
+DEFSUITE( "Quote" );
+
+static std::string Escape( EscapeFunc f, const std::string & s ) {
+	std::vector <char> buf( 2 * s.size() + 1 );
+	return std::string( &buf[0], f( &buf[0], s.data(), s.size() ) );
+}
+
+DEFTEST( Scalar ) {
+	FAILNE( Escape( EscapeScalar, "" ), "" );
+	FAILNE( Escape( EscapeScalar, "abc" ), "abc" );
+	FAILNE( Escape( EscapeScalar, "\"a\"\"" ), "\"\"a\"\"\"\"" );
+}
+
+// every version must agree with the scalar one, with quotes at all
+// positions relative to the block boundaries
+DEFTEST( Vector ) {
+	std::vector <EscapeFunc> fs;
+	fs.push_back( CSVEscape );
+#ifdef DMK_SIMD_QUOTE
+	__builtin_cpu_init();
+	if ( __builtin_cpu_supports( "sse2" ) ) {
+		fs.push_back( EscapeSSE2 );
+	}
+	if ( __builtin_cpu_supports( "avx2" ) ) {
+		fs.push_back( EscapeAVX2 );
+	}
+#endif
+	for ( unsigned int len = 0; len < 100; len++ ) {
+		for ( unsigned int q = 0; q <= len; q++ ) {
+			std::string s( len, 'x' );
+			if ( q < len ) {
+				s[q] = '"';
+			}
+			if ( len > 40 ) {
+				s[len - 1] = '"';
+				s[len / 2] = '"';
+			}
+			std::string good = Escape( EscapeScalar, s );
+			for ( unsigned int i = 0; i < fs.size(); i++ ) {
+				FAILNE( Escape( fs[i], s ), good );
+			}
+		}
+	}
+}
+
+#endif
+
+//----------------------------------------------------------------------------
+
+// end
+
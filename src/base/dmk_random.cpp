@@ -2,7 +2,9 @@
 // dmk_random.cpp
 //
 // random number generation for dmk
-// we now use boost to supply random numbers & distributions
+// random numbers come from our own counter-based generator, and are turned
+// into distributions in bulk. The bulk kernels have AVX2 versions, picked
+// at run-time, which give exactly the same values as the plain versions.
 //
 // Copyright (C) 2009 Neil Butterworth
 //---------------------------------------------------------------------------
@@ -10,9 +12,14 @@
 #include "dmk_base.h"
 #include "dmk_random.h"
 
-#include "boost/random.hpp"
-#include "boost/generator_iterator.hpp"
-#include "boost/shared_ptr.hpp"
+#include <climits>
+#include <cfloat>
+#include <cmath>
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define DMK_SIMD_RANDOM
+#include <immintrin.h>
+#endif
 
 using std::string;
 using std::vector;
@@ -20,11 +27,433 @@ using std::vector;
 namespace DMK {
 
 //----------------------------------------------------------------------------
-// Global random number generator
+// Philox constants - multipliers and Weyl sequence key increments
 //----------------------------------------------------------------------------
 
-typedef boost::minstd_rand RNGType;
-static RNGType theGen;
+const unsigned int PHILOX_M0 = 0xD2511F53;
+const unsigned int PHILOX_M1 = 0xCD9E8D57;
+const unsigned int PHILOX_W0 = 0x9E3779B9;
+const unsigned int PHILOX_W1 = 0xBB67AE85;
+const unsigned int PHILOX_ROUNDS = 10;
+
+//----------------------------------------------------------------------------
+// Streams start at the beginning of substream zero
+//----------------------------------------------------------------------------
+
+RandomStream :: RandomStream( unsigned long long key )
+	: mKey( key ), mSub( 0 ), mPos( 0 ), mFilled( false ) {
+}
+
+void RandomStream :: SetKey( unsigned long long key ) {
+	mKey = key;
+	mFilled = false;
+}
+
+unsigned long long RandomStream :: Key() const {
+	return mKey;
+}
+
+//----------------------------------------------------------------------------
+// Move to the start of substream n
+//----------------------------------------------------------------------------
+
+void RandomStream :: Substream( unsigned long long n ) {
+	mSub = n;
+	mPos = 0;
+	mFilled = false;
+}
+
+//----------------------------------------------------------------------------
+// Move to value pos of the current substream. Values are made four at a
+// time, so the block is recalculated on the next call.
+//----------------------------------------------------------------------------
+
+void RandomStream :: Seek( unsigned long long pos ) {
+	mPos = pos;
+	mFilled = false;
+}
+
+unsigned long long RandomStream :: Tell() const {
+	return mPos;
+}
+
+//----------------------------------------------------------------------------
+// The Philox4x32 bijection - the counter is scrambled by ten rounds of
+// multiplication, with the key mixed in at each round.
+//----------------------------------------------------------------------------
+
+void RandomStream :: Block( const unsigned int ctr[4],
+							const unsigned int key[2],
+							unsigned int out[4] ) {
+	unsigned int c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+	unsigned int k0 = key[0], k1 = key[1];
+	for ( unsigned int i = 0; i < PHILOX_ROUNDS; i++ ) {
+		unsigned long long p0 = (unsigned long long) PHILOX_M0 * c0;
+		unsigned long long p1 = (unsigned long long) PHILOX_M1 * c2;
+		unsigned int hi0 = p0 >> 32, lo0 = (unsigned int) p0;
+		unsigned int hi1 = p1 >> 32, lo1 = (unsigned int) p1;
+		c0 = hi1 ^ c1 ^ k0;
+		c1 = lo1;
+		c2 = hi0 ^ c3 ^ k1;
+		c3 = lo0;
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	out[3] = c3;
+}
+
+//----------------------------------------------------------------------------
+// Bulk kernels. Philox makes nblocks blocks of four values, starting at
+// block blk of a substream. Unit turns pairs of values into reals in
+// [0,1), scaled and offset, and Triangle applies the triangular inverse
+// CDF to such reals. The vector versions use the same operations in the
+// same order as the plain ones, so results don't depend on the processor.
+// They clear the upper halves of the vector registers before handing the
+// tail to a plain version, as mixing the two is very slow on some chips.
+//----------------------------------------------------------------------------
+
+typedef void (* PhiloxFunc)( unsigned long long blk, unsigned long long sub,
+								unsigned long long key,
+								unsigned int * out, unsigned int nblocks );
+typedef void (* UnitFunc)( const unsigned int * bits, double * out,
+								unsigned int n, double offset, double scale );
+typedef void (* TriangleFunc)( double * u, unsigned int n,
+								double begin, double mode, double end );
+
+const double TWO_26 = 67108864.0;
+const double TWO_M53 = 1.0 / 9007199254740992.0;
+
+static void PhiloxScalar( unsigned long long blk, unsigned long long sub,
+							unsigned long long key,
+							unsigned int * out, unsigned int nblocks ) {
+	unsigned int k[2] = { (unsigned int) key, (unsigned int)( key >> 32 ) };
+	for ( unsigned int i = 0; i < nblocks; i++, blk++, out += 4 ) {
+		unsigned int ctr[4] = {
+			(unsigned int) blk, (unsigned int)( blk >> 32 ),
+			(unsigned int) sub, (unsigned int)( sub >> 32 )
+		};
+		RandomStream::Block( ctr, k, out );
+	}
+}
+
+static void UnitScalar( const unsigned int * bits, double * out,
+							unsigned int n, double offset, double scale ) {
+	for ( unsigned int i = 0; i < n; i++ ) {
+		double hi = bits[2 * i] >> 5, lo = bits[2 * i + 1] >> 6;
+		double u = (hi * TWO_26 + lo) * TWO_M53;
+		out[i] = offset + u * scale;
+	}
+}
+
+static void TriangleScalar( double * u, unsigned int n,
+								double begin, double mode, double end ) {
+	double range = end - begin, split = (mode - begin) / range;
+	for ( unsigned int i = 0; i < n; i++ ) {
+		if ( u[i] < split ) {
+			u[i] = begin + std::sqrt( u[i] * range * (mode - begin) );
+		}
+		else {
+			u[i] = end - std::sqrt( (1.0 - u[i]) * range * (end - mode) );
+		}
+	}
+}
+
+#ifdef DMK_SIMD_RANDOM
+
+// four blocks at a time, each in the low half of a 64-bit lane
+__attribute__(( target( "avx2" ) ))
+static void PhiloxAVX2( unsigned long long blk, unsigned long long sub,
+							unsigned long long key,
+							unsigned int * out, unsigned int nblocks ) {
+	const __m256i m0 = _mm256_set1_epi64x( PHILOX_M0 );
+	const __m256i m1 = _mm256_set1_epi64x( PHILOX_M1 );
+	const __m256i s0 = _mm256_set1_epi64x( (unsigned int) sub );
+	const __m256i s1 = _mm256_set1_epi64x( (unsigned int)( sub >> 32 ) );
+	for ( ; nblocks >= 4; nblocks -= 4, blk += 4, out += 16 ) {
+		__m256i c0 = _mm256_set_epi64x(
+			(unsigned int)( blk + 3 ), (unsigned int)( blk + 2 ),
+			(unsigned int)( blk + 1 ), (unsigned int) blk );
+		__m256i c1 = _mm256_set_epi64x(
+			(unsigned int)( (blk + 3) >> 32 ), (unsigned int)( (blk + 2) >> 32 ),
+			(unsigned int)( (blk + 1) >> 32 ), (unsigned int)( blk >> 32 ) );
+		__m256i c2 = s0, c3 = s1;
+		unsigned int k0 = (unsigned int) key, k1 = (unsigned int)( key >> 32 );
+		for ( unsigned int r = 0; r < PHILOX_ROUNDS; r++ ) {
+			__m256i p0 = _mm256_mul_epu32( c0, m0 );
+			__m256i p1 = _mm256_mul_epu32( c2, m1 );
+			c0 = _mm256_xor_si256( _mm256_xor_si256( _mm256_srli_epi64( p1, 32 ), c1 ),
+									_mm256_set1_epi64x( k0 ) );
+			c1 = p1;
+			c2 = _mm256_xor_si256( _mm256_xor_si256( _mm256_srli_epi64( p0, 32 ), c3 ),
+									_mm256_set1_epi64x( k1 ) );
+			c3 = p0;
+			k0 += PHILOX_W0;
+			k1 += PHILOX_W1;
+		}
+		unsigned long long t[4][4];
+		_mm256_storeu_si256( (__m256i *) t[0], c0 );
+		_mm256_storeu_si256( (__m256i *) t[1], c1 );
+		_mm256_storeu_si256( (__m256i *) t[2], c2 );
+		_mm256_storeu_si256( (__m256i *) t[3], c3 );
+		for ( unsigned int j = 0; j < 4; j++ ) {
+			out[4 * j] = (unsigned int) t[0][j];
+			out[4 * j + 1] = (unsigned int) t[1][j];
+			out[4 * j + 2] = (unsigned int) t[2][j];
+			out[4 * j + 3] = (unsigned int) t[3][j];
+		}
+	}
+	_mm256_zeroupper();
+	PhiloxScalar( blk, sub, key, out, nblocks );
+}
+
+// the high and low parts of each pair both fit in an int, so can use the
+// int to double conversion
+__attribute__(( target( "avx2" ) ))
+static void UnitAVX2( const unsigned int * bits, double * out,
+						unsigned int n, double offset, double scale ) {
+	const __m256i split = _mm256_set_epi32( 7, 5, 3, 1, 6, 4, 2, 0 );
+	const __m256d two26 = _mm256_set1_pd( TWO_26 );
+	const __m256d twom53 = _mm256_set1_pd( TWO_M53 );
+	const __m256d off = _mm256_set1_pd( offset );
+	const __m256d sc = _mm256_set1_pd( scale );
+	unsigned int i = 0;
+	for ( ; i + 4 <= n; i += 4 ) {
+		__m256i v = _mm256_loadu_si256( (const __m256i *)( bits + 2 * i ) );
+		__m256i hi = _mm256_permutevar8x32_epi32( _mm256_srli_epi32( v, 5 ), split );
+		__m256i lo = _mm256_permutevar8x32_epi32( _mm256_srli_epi32( v, 6 ), split );
+		__m256d dhi = _mm256_cvtepi32_pd( _mm256_castsi256_si128( hi ) );
+		__m256d dlo = _mm256_cvtepi32_pd( _mm256_extracti128_si256( lo, 1 ) );
+		__m256d u = _mm256_mul_pd( _mm256_add_pd( _mm256_mul_pd( dhi, two26 ), dlo ),
+									twom53 );
+		_mm256_storeu_pd( out + i, _mm256_add_pd( off, _mm256_mul_pd( u, sc ) ) );
+	}
+	_mm256_zeroupper();
+	UnitScalar( bits + 2 * i, out + i, n - i, offset, scale );
+}
+
+// both sides of the mode are calculated, and the right one picked
+__attribute__(( target( "avx2" ) ))
+static void TriangleAVX2( double * u, unsigned int n,
+							double begin, double mode, double end ) {
+	double range = end - begin, split = (mode - begin) / range;
+	const __m256d b = _mm256_set1_pd( begin ), e = _mm256_set1_pd( end );
+	const __m256d r = _mm256_set1_pd( range ), sp = _mm256_set1_pd( split );
+	const __m256d lm = _mm256_set1_pd( mode - begin );
+	const __m256d rm = _mm256_set1_pd( end - mode );
+	const __m256d one = _mm256_set1_pd( 1.0 );
+	unsigned int i = 0;
+	for ( ; i + 4 <= n; i += 4 ) {
+		__m256d v = _mm256_loadu_pd( u + i );
+		__m256d left = _mm256_add_pd( b,
+			_mm256_sqrt_pd( _mm256_mul_pd( _mm256_mul_pd( v, r ), lm ) ) );
+		__m256d right = _mm256_sub_pd( e,
+			_mm256_sqrt_pd( _mm256_mul_pd(
+				_mm256_mul_pd( _mm256_sub_pd( one, v ), r ), rm ) ) );
+		__m256d isleft = _mm256_cmp_pd( v, sp, _CMP_LT_OQ );
+		_mm256_storeu_pd( u + i, _mm256_blendv_pd( right, left, isleft ) );
+	}
+	_mm256_zeroupper();
+	TriangleScalar( u + i, n - i, begin, mode, end );
+}
+
+#endif
+
+//----------------------------------------------------------------------------
+// Pick the best kernels for this processor
+//----------------------------------------------------------------------------
+
+struct RandomKernels {
+	PhiloxFunc mPhilox;
+	UnitFunc mUnit;
+	TriangleFunc mTriangle;
+};
+
+static RandomKernels ChooseKernels() {
+	RandomKernels k = { PhiloxScalar, UnitScalar, TriangleScalar };
+#ifdef DMK_SIMD_RANDOM
+	__builtin_cpu_init();
+	if ( __builtin_cpu_supports( "avx2" ) ) {
+		RandomKernels avx = { PhiloxAVX2, UnitAVX2, TriangleAVX2 };
+		k = avx;
+	}
+#endif
+	return k;
+}
+
+static const RandomKernels & Kernels() {
+	static const RandomKernels k = ChooseKernels();
+	return k;
+}
+
+//----------------------------------------------------------------------------
+// Get next 32-bit value. The counter is the block number within the
+// substream followed by the substream number.
+//----------------------------------------------------------------------------
+
+RandomStream::result_type RandomStream :: operator()() {
+	if ( ! mFilled || (mPos & 3) == 0 ) {
+		unsigned long long blk = mPos >> 2;
+		unsigned int ctr[4] = {
+			(unsigned int) blk, (unsigned int)( blk >> 32 ),
+			(unsigned int) mSub, (unsigned int)( mSub >> 32 )
+		};
+		unsigned int key[2] = {
+			(unsigned int) mKey, (unsigned int)( mKey >> 32 )
+		};
+		Block( ctr, key, mBlock );
+		mFilled = true;
+	}
+	return mBlock[ mPos++ & 3 ];
+}
+
+//----------------------------------------------------------------------------
+// Get n values in one go. Whole blocks are made directly in the output,
+// so only a part block at either end goes through operator().
+//----------------------------------------------------------------------------
+
+void RandomStream :: Fill( result_type * out, unsigned int n ) {
+	while( n && (mPos & 3) ) {
+		*out++ = (*this)();
+		n--;
+	}
+	unsigned int nblocks = n / 4;
+	if ( nblocks ) {
+		Kernels().mPhilox( mPos >> 2, mSub, mKey, out, nblocks );
+		mPos += 4ULL * nblocks;
+		mFilled = false;
+		out += 4 * nblocks;
+		n -= 4 * nblocks;
+	}
+	while( n-- ) {
+		*out++ = (*this)();
+	}
+}
+
+RandomStream::result_type RandomStream :: min() const {
+	return 0;
+}
+
+RandomStream::result_type RandomStream :: max() const {
+	return 0xFFFFFFFF;
+}
+
+//----------------------------------------------------------------------------
+// Non-negative int, with the same range as the old minstd generator
+//----------------------------------------------------------------------------
+
+int RandomStream :: Random() {
+	return int( (*this)() >> 1 );
+}
+
+//----------------------------------------------------------------------------
+// Get random number in range [begin,end)
+//----------------------------------------------------------------------------
+
+int RandomStream :: Random( int begin, int end ) {
+	if ( begin >= end ) {
+		throw Exception( "Invalid random number range" );
+	}
+	return begin + int( Below( (unsigned int) end - (unsigned int) begin ) );
+}
+
+//----------------------------------------------------------------------------
+// Unbiased random number in range [0,n) by Lemire's method - the top half
+// of the 64 bit product of a stream value and n, rejecting the few values
+// whose low half shows they would be over-represented. The threshold needs
+// a divide, but is only worked out when the low half is small enough that
+// a value might be rejected, which is rare unless n is huge.
+//----------------------------------------------------------------------------
+
+static inline bool BelowAccept( unsigned int x, unsigned int n,
+								unsigned int & out ) {
+	unsigned long long m = (unsigned long long) x * n;
+	unsigned int low = (unsigned int) m;
+	if ( low < n && low < ( 0u - n ) % n ) {
+		return false;
+	}
+	out = (unsigned int)( m >> 32 );
+	return true;
+}
+
+unsigned int RandomStream :: Below( unsigned int n ) {
+	if ( n == 0 ) {
+		throw Exception( "Invalid random number range" );
+	}
+	unsigned int r;
+	while( ! BelowAccept( (*this)(), n, r ) ) {
+	}
+	return r;
+}
+
+//----------------------------------------------------------------------------
+// As Below() for ranges that may not fit in 32 bits. Ranges that do fit
+// give the same values as Below(); bigger ones use two stream values and
+// reject those below 2^64 mod n, so the remainder is unbiased.
+//----------------------------------------------------------------------------
+
+unsigned long long RandomStream :: Below64( unsigned long long n ) {
+	if ( n <= 0xffffffffULL ) {
+		return Below( (unsigned int) n );
+	}
+	unsigned long long lim = ( 0ULL - n ) % n, x;
+	do {
+		x = (unsigned long long) (*this)() << 32;
+		x |= (*this)();
+	} while( x < lim );
+	return x % n;
+}
+
+//----------------------------------------------------------------------------
+// Block of numbers in [0,n), the same as calling Below() count times. The
+// stream values are made in bulk in the output array and converted in
+// place, with any rejects topped up by further fills.
+//----------------------------------------------------------------------------
+
+void RandomStream :: FillBelow( unsigned int n, unsigned int * out,
+									unsigned int count ) {
+	if ( n == 0 ) {
+		throw Exception( "Invalid random number range" );
+	}
+	unsigned int done = 0;
+	while( done < count ) {
+		unsigned int end = count;
+		Fill( out + done, end - done );
+		for ( unsigned int i = done; i < end; i++ ) {
+			if ( BelowAccept( out[i], n, out[done] ) ) {
+				done++;
+			}
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+// Real in range [0,1) using 53 random bits
+//----------------------------------------------------------------------------
+
+double RandomStream :: Real() {
+	double hi = (*this)() >> 5, lo = (*this)() >> 6;
+	return (hi * TWO_26 + lo) * TWO_M53;
+}
+
+//----------------------------------------------------------------------------
+// Global random number stream
+//----------------------------------------------------------------------------
+
+static RandomStream theGen;
+
+//----------------------------------------------------------------------------
+// Mix seed or stream id into a well-distributed 64-bit key (splitmix64)
+//----------------------------------------------------------------------------
+
+static unsigned long long MixKey( unsigned long long x ) {
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
 
 //----------------------------------------------------------------------------
 // Default RNG seed
@@ -40,8 +469,8 @@ bool RNG::mNeedRandomise = true;
 void RNG :: Randomise( int n ) {
 	mNeedRandomise = false;
 	mLastSeed = n;
-	theGen.seed( n );
-	theGen();
+	theGen.SetKey( MixKey( (unsigned int) n ) );
+	theGen.Substream( 0 );
 }
 
 //----------------------------------------------------------------------------
@@ -56,24 +485,12 @@ void RNG::Randomise() {
 
 //----------------------------------------------------------------------------
 // Get random number in range [begin,end) - not used much in current code
-// which uses distributions.
+// which uses distributions and per-source streams.
 //----------------------------------------------------------------------------
 
 int RNG :: Random( int begin, int end ) {
-	if ( mNeedRandomise  ) {
-		Randomise( mLastSeed );
-	}
-
-	if ( begin >= end ) {
-		throw Exception( "Invalid random number range" );
-	}
-	int n = end - begin;
-	const int bsize = INT_MAX / n;
-	int r;
-	do {
-		r = theGen() / bsize;
-	} while( r >= n );
-	return begin + r;
+	Randomise();
+	return theGen.Random( begin, end );
 }
 
 //----------------------------------------------------------------------------
@@ -81,10 +498,17 @@ int RNG :: Random( int begin, int end ) {
 //----------------------------------------------------------------------------
 
 int RNG :: Random() {
-	if ( mNeedRandomise ) {
-		Randomise( mLastSeed );
-	}
-	return theGen();
+	Randomise();
+	return theGen.Random();
+}
+
+//----------------------------------------------------------------------------
+// Get unbiased random number in range [0,n)
+//----------------------------------------------------------------------------
+
+unsigned int RNG :: Below( unsigned int n ) {
+	Randomise();
+	return theGen.Below( n );
 }
 
 //----------------------------------------------------------------------------
@@ -96,110 +520,935 @@ int RNG :: GetSeed() {
 }
 
 //----------------------------------------------------------------------------
-// Implementation of trianguular distribution
-// These should probably be templated
+// Key for the stream named id under the current seed. The name is hashed
+// with FNV-1a, so the same name always gets the same stream.
+//----------------------------------------------------------------------------
+
+unsigned long long RNG :: StreamKey( const string & id ) {
+	Randomise();
+	unsigned long long h = 0xCBF29CE484222325ULL;
+	for ( unsigned int i = 0; i < id.size(); i++ ) {
+		h = (h ^ (unsigned char) id[i]) * 0x100000001B3ULL;
+	}
+	return MixKey( MixKey( (unsigned int) mLastSeed ) ^ h );
+}
+
+//----------------------------------------------------------------------------
+// Alias tables. Each slot holds the chance of picking the slot itself,
+// and the index to pick otherwise.
 //----------------------------------------------------------------------------
 
-struct TDImpl {
+AliasTable :: AliasTable() {
+}
+
+AliasTable :: AliasTable( const vector <double> & weights ) {
+	Build( weights );
+}
 
-	typedef boost::triangle_distribution <double> DistType;
-	typedef boost::variate_generator<RNGType&, DistType> GenType;
-	typedef boost::generator_iterator<GenType> IterType;
+//----------------------------------------------------------------------------
+// Scale weights so the average is one, then repeatedly fill up a slot
+// below one with the excess from a slot above one.
+//----------------------------------------------------------------------------
 
-	GenType mGen;
-	IterType mIter;
+void AliasTable :: Build( const vector <double> & weights ) {
+	unsigned int n = weights.size();
+	double sum = 0;
+	for ( unsigned int i = 0; i < n; i++ ) {
+		if ( ! (weights[i] >= 0) || weights[i] > DBL_MAX ) {
+			throw Exception( "Weights must be non-negative numbers" );
+		}
+		sum += weights[i];
+	}
+	if ( n == 0 || ! (sum > 0) || sum > DBL_MAX ) {
+		throw Exception( "Weights must have a positive total" );
+	}
 
-	TDImpl( double begin, double mode, double end )
-		: mGen( theGen, DistType( begin, mode, end ) ), mIter( &mGen ) {
+	vector <double> scaled( n );
+	vector <unsigned int> small, large;
+	for ( unsigned int i = 0; i < n; i++ ) {
+		scaled[i] = weights[i] * n / sum;
+		if ( scaled[i] < 1.0 ) {
+			small.push_back( i );
+		}
+		else {
+			large.push_back( i );
+		}
 	}
 
-	double Next() {
-		return * mIter++;
+	mProb.assign( n, 1.0 );
+	mAlias.resize( n );
+	for ( unsigned int i = 0; i < n; i++ ) {
+		mAlias[i] = i;
 	}
-};
+	while( small.size() && large.size() ) {
+		unsigned int s = small.back(), l = large.back();
+		small.pop_back();
+		large.pop_back();
+		mProb[s] = scaled[s];
+		mAlias[s] = l;
+		scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+		if ( scaled[l] < 1.0 ) {
+			small.push_back( l );
+		}
+		else {
+			large.push_back( l );
+		}
+	}
+	// anything left is one, give or take rounding, so keeps prob of 1
+}
+
+unsigned int AliasTable :: Size() const {
+	return mProb.size();
+}
 
 //----------------------------------------------------------------------------
-// Implementation of uniform distribution
+// One real picks both the slot and the side of the slot
 //----------------------------------------------------------------------------
 
-struct UDImpl {
+unsigned int AliasTable :: Pick( RandomStream & rs ) const {
+	return Pick( rs.Real() );
+}
+
+unsigned int AliasTable :: Pick( double u ) const {
+	u *= mProb.size();
+	unsigned int i = (unsigned int) u;
+	return u - i < mProb[i] ? i : mAlias[i];
+}
+
+//----------------------------------------------------------------------------
+// Permutations. Each round key is mixed from the key and round number, and
+// the round function is the splitmix finaliser of the half and round key.
+//----------------------------------------------------------------------------
 
-	typedef boost::uniform_real <double> DistType;
-	typedef boost::variate_generator<RNGType&, DistType> GenType;
-	typedef boost::generator_iterator<GenType> IterType;
+Permutation :: Permutation( unsigned long long n, unsigned long long key )
+	: mSize( n ), mBits( 1 ) {
+	if ( n == 0 ) {
+		throw Exception( "Cannot permute empty range" );
+	}
+	while( mBits < 32 && ( 1ULL << (2 * mBits) ) < n ) {
+		mBits++;
+	}
+	mMask = ( 1ULL << mBits ) - 1;
+	for ( unsigned int r = 0; r < ROUNDS; r++ ) {
+		mKeys[r] = MixKey( key + r );
+	}
+}
 
-	GenType mGen;
-	IterType mIter;
+unsigned long long Permutation :: Size() const {
+	return mSize;
+}
 
-	UDImpl( double begin, double end )
-		: mGen( theGen, DistType( begin, end ) ), mIter( &mGen ) {
+unsigned long long Permutation :: Encrypt( unsigned long long x ) const {
+	unsigned long long left = x >> mBits, right = x & mMask;
+	for ( unsigned int r = 0; r < ROUNDS; r++ ) {
+		unsigned long long f = MixKey( right ^ mKeys[r] );
+		unsigned long long t = right;
+		right = ( left ^ f ) & mMask;
+		left = t;
 	}
+	return ( left << mBits ) | right;
+}
 
-	double Next() {
-		return * mIter++;
+unsigned long long Permutation :: At( unsigned long long i ) const {
+	if ( i >= mSize ) {
+		throw Exception( "Invalid permutation index" );
 	}
-};
+	do {
+		i = Encrypt( i );
+	} while( i >= mSize );
+	return i;
+}
+
+//----------------------------------------------------------------------------
+// Count through as many trailing sets as will fit in 64 bits
+//----------------------------------------------------------------------------
 
+UniqueStrings :: UniqueStrings( const vector <string> & charsets )
+	: mSets( charsets ), mFirst( charsets.size() ), mSize( 1 ), mCount( 0 ) {
+	while( mFirst > 0 ) {
+		unsigned long long n = mSets[ mFirst - 1 ].size();
+		if ( n == 0 ) {
+			throw Exception( "Empty character set" );
+		}
+		if ( mSize > ULLONG_MAX / n ) {
+			break;
+		}
+		mSize *= n;
+		mFirst--;
+	}
+}
 
+unsigned long long UniqueStrings :: Size() const {
+	return mSize;
+}
 
 //----------------------------------------------------------------------------
-// Base virtual dtor
+// The permutation's key comes from the stream on first use
 //----------------------------------------------------------------------------
 
+string UniqueStrings :: Next( RandomStream & rs ) {
+	if ( mCount == 0 ) {
+		unsigned long long key = rs();
+		mPerm = Permutation( mSize, (key << 32) | rs() );
+	}
+	else if ( mCount == mSize ) {
+		throw Exception( "No more unique values" );
+	}
+	string s( mSets.size(), ' ' );
+	for ( unsigned int i = 0; i < mFirst; i++ ) {
+		s[i] = mSets[i][ rs.Below( mSets[i].size() ) ];
+	}
+	unsigned long long x = mPerm.At( mCount++ );
+	for ( unsigned int i = mSets.size(); i > mFirst; i-- ) {
+		const string & set = mSets[ i - 1 ];
+		s[ i - 1 ] = set[ x % set.size() ];
+		x /= set.size();
+	}
+	return s;
+}
+
+//----------------------------------------------------------------------------
+// Distributions draw from the stream they are given
+//----------------------------------------------------------------------------
+
+Distribution :: Distribution( RandomStream & rs )
+		: mStream( rs ), mPoolPos( 0 ) {
+}
+
 Distribution :: ~Distribution() {
 	// nothing
 }
 
+double Distribution :: NextReal() {
+	double d;
+	FillReal( &d, 1 );
+	return d;
+}
+
+int Distribution :: NextInt() {
+	int n;
+	FillInt( &n, 1 );
+	return n;
+}
+
 //----------------------------------------------------------------------------
-// Triangle distribution uses a mode to skew the distribution
+// Ints are the reals truncated towards zero
+//----------------------------------------------------------------------------
+
+void Distribution :: FillInt( int * out, unsigned int n ) {
+	if ( mReals.size() < n ) {
+		mReals.resize( n );
+	}
+	FillReal( &mReals[0], n );
+	for ( unsigned int i = 0; i < n; i++ ) {
+		out[i] = int( mReals[i] );
+	}
+}
+
+//----------------------------------------------------------------------------
+// Uniform reals in [offset, offset + scale), each using two stream values
+//----------------------------------------------------------------------------
+
+void Distribution :: FillUnit( double * out, unsigned int n,
+								double offset, double scale ) {
+	if ( mBits.size() < 2 * n ) {
+		mBits.resize( 2 * n );
+	}
+	mStream.Fill( &mBits[0], 2 * n );
+	if ( n < 4 ) {
+		UnitScalar( &mBits[0], out, n, offset, scale );
+	}
+	else {
+		Kernels().mUnit( &mBits[0], out, n, offset, scale );
+	}
+}
+
+//----------------------------------------------------------------------------
+// Next stream value from the pool, refilling it a block at a time, and
+// uniforms in [0,1) made from them the same way as FillUnit() does
 //----------------------------------------------------------------------------
 
-TriangleDist :: TriangleDist( double begin, double mode, double end )
-		: mImpl( new TDImpl( begin, mode, end ) ) {
+unsigned int Distribution :: Word() {
+	if ( mPoolPos == mPool.size() ) {
+		mPool.resize( 512 );
+		mStream.Fill( &mPool[0], mPool.size() );
+		mPoolPos = 0;
+	}
+	return mPool[ mPoolPos++ ];
 }
 
-TriangleDist :: ~TriangleDist() {
-	delete mImpl;
+double Distribution :: Unit() {
+	double hi = Word() >> 5, lo = Word() >> 6;
+	return (hi * TWO_26 + lo) * TWO_M53;
 }
 
-double TriangleDist :: NextReal() {
-	RNG::Randomise();
-	return mImpl->Next();
+//----------------------------------------------------------------------------
+// Triangle distribution uses a mode to skew the distribution
+//----------------------------------------------------------------------------
+
+TriangleDist :: TriangleDist( RandomStream & rs,
+								double begin, double mode, double end )
+		: Distribution( rs ), mBegin( begin ), mMode( mode ), mEnd( end ) {
 }
 
-int TriangleDist :: NextInt() {
-	RNG::Randomise();
-	return int( mImpl->Next() );
+void TriangleDist :: FillReal( double * out, unsigned int n ) {
+	FillUnit( out, n );
+	if ( n < 4 ) {
+		TriangleScalar( out, n, mBegin, mMode, mEnd );
+	}
+	else {
+		Kernels().mTriangle( out, n, mBegin, mMode, mEnd );
+	}
 }
 
 //----------------------------------------------------------------------------
 // Uniform distributions spreads values across range
 //----------------------------------------------------------------------------
 
-UniformDist :: UniformDist( double begin, double end )
-		: mImpl( new UDImpl( begin,  end ) ) {
+UniformDist :: UniformDist( RandomStream & rs, double begin, double end )
+		: Distribution( rs ), mBegin( begin ), mEnd( end ) {
+}
+
+void UniformDist :: FillReal( double * out, unsigned int n ) {
+	FillUnit( out, n, mBegin, mEnd - mBegin );
+}
+
+//----------------------------------------------------------------------------
+// Zipf distribution by rejection-inversion (Hormann & Derflinger 1996).
+// A value is made by inverting the integral of the continuous hat function
+// 1 / x^s at a uniform point, and accepted unless it falls in the sliver
+// between the hat and the step function of the real weights - which for
+// any s is rare enough that most values need one uniform.
+//----------------------------------------------------------------------------
+
+// log(1+x)/x and (exp(x)-1)/x, accurate near zero
+static double Log1pOver( double x ) {
+	return std::fabs( x ) > 1e-8
+			? ::log1p( x ) / x
+			: 1.0 - x * ( 0.5 - x * ( 1.0 / 3.0 - 0.25 * x ) );
+}
+
+static double Expm1Over( double x ) {
+	return std::fabs( x ) > 1e-8
+			? ::expm1( x ) / x
+			: 1.0 + x * 0.5 * ( 1.0 + x / 3.0 * ( 1.0 + 0.25 * x ) );
+}
+
+ZipfDist :: ZipfDist( RandomStream & rs, double n, double s )
+		: Distribution( rs ), mN( n ), mS( s ) {
+	if ( ! (n >= 1) || n > 9007199254740992.0 || std::floor( n ) != n ) {
+		throw Exception( "Zipf distribution needs a whole number of ranks" );
+	}
+	if ( ! (s > 0) || s > DBL_MAX ) {
+		throw Exception( "Zipf exponent must be greater than zero" );
+	}
+	mHX1 = HIntegral( 1.5 ) - 1.0;
+	mHN = HIntegral( mN + 0.5 );
+	mCut = 2.0 - HIntegralInverse( HIntegral( 2.5 ) - H( 2.0 ) );
+}
+
+double ZipfDist :: H( double x ) const {
+	return std::exp( -mS * std::log( x ) );
+}
+
+double ZipfDist :: HIntegral( double x ) const {
+	double lx = std::log( x );
+	return Expm1Over( ( 1.0 - mS ) * lx ) * lx;
+}
+
+double ZipfDist :: HIntegralInverse( double x ) const {
+	double t = x * ( 1.0 - mS );
+	if ( t < -1.0 ) {
+		t = -1.0;		// only reached through rounding
+	}
+	return std::exp( Log1pOver( t ) * x );
+}
+
+void ZipfDist :: FillReal( double * out, unsigned int n ) {
+	for ( unsigned int i = 0; i < n; i++ ) {
+		for ( ; ; ) {
+			double u = mHN + Unit() * ( mHX1 - mHN );
+			double x = HIntegralInverse( u );
+			double k = std::floor( x + 0.5 );
+			if ( k < 1.0 ) {
+				k = 1.0;
+			}
+			else if ( k > mN ) {
+				k = mN;
+			}
+			if ( k - x <= mCut || u >= HIntegral( k + 0.5 ) - H( k ) ) {
+				out[i] = k;
+				break;
+			}
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+// Ziggurat tables. The area under the decreasing curve f is covered by n
+// layers of equal area v - a base layer including the tail beyond r, and
+// n-1 rectangles stacked on it. mX[i] is the width of layer i (for the
+// base, the width a rectangle of area v would have), mF[i] = f(mX[i]) and
+// mRatio[i] is the fraction of layer i lying wholly under the curve.
+//----------------------------------------------------------------------------
+
+struct Ziggurat {
+
+	typedef double (* Func)( double );
+
+	Ziggurat( unsigned int n, double r, double v, Func f, Func finv ) {
+		mX.resize( n + 1 );
+		mF.resize( n + 1 );
+		mRatio.resize( n );
+		mX[0] = v / f( r );
+		mX[1] = r;
+		for ( unsigned int i = 1; i < n - 1; i++ ) {
+			mX[i + 1] = finv( v / mX[i] + f( mX[i] ) );
+		}
+		mX[n] = 0;
+		for ( unsigned int i = 0; i <= n; i++ ) {
+			mF[i] = f( mX[i] );
+		}
+		for ( unsigned int i = 0; i < n; i++ ) {
+			mRatio[i] = mX[i + 1] / mX[i];
+		}
+	}
+
+	std::vector <double> mX, mF, mRatio;
+};
+
+static double NormalF( double x ) {
+	return std::exp( -0.5 * x * x );
+}
+
+static double NormalFInv( double y ) {
+	return std::sqrt( -2.0 * std::log( y ) );
+}
+
+static double ExpF( double x ) {
+	return std::exp( -x );
+}
+
+static double ExpFInv( double y ) {
+	return -std::log( y );
+}
+
+// constants for 128 and 256 layers from Marsaglia & Tsang
+static const Ziggurat & NormalZiggurat() {
+	static const Ziggurat z( 128, 3.442619855899, 9.91256303526217e-3,
+								NormalF, NormalFInv );
+	return z;
+}
+
+static const Ziggurat & ExpZiggurat() {
+	static const Ziggurat z( 256, 7.69711747013104972, 3.949659822581572e-3,
+								ExpF, ExpFInv );
+	return z;
+}
+
+//----------------------------------------------------------------------------
+// Normal & log-normal. Two stream values give the layer (low 7 bits), the
+// sign (bit 7) and a 53 bit uniform (the top 21 bits of the first value
+// and all of the second). Points outside the inner part of a layer are
+// either in the tail, sampled by Marsaglia's method, or in the wedge
+// between rectangle and curve, where they are checked against the curve.
+//----------------------------------------------------------------------------
+
+static void CheckNormal( double mean, double sd ) {
+	if ( ! (sd >= 0) || sd > DBL_MAX || ! (std::fabs( mean ) <= DBL_MAX) ) {
+		throw Exception( "Invalid normal distribution parameters" );
+	}
+}
+
+NormalDist :: NormalDist( RandomStream & rs, double mean, double sd,
+							bool lognormal )
+		: Distribution( rs ), mMean( mean ), mSD( sd ), mLog( lognormal ) {
+	CheckNormal( mean, sd );
+}
+
+void NormalDist :: FillReal( double * out, unsigned int n ) {
+	const Ziggurat & z = NormalZiggurat();
+	const double r = z.mX[1];
+	for ( unsigned int i = 0; i < n; i++ ) {
+		double x;
+		for ( ; ; ) {
+			unsigned int w1 = Word(), w2 = Word();
+			unsigned int layer = w1 & 127;
+			double u = ( double( w1 >> 11 ) * 4294967296.0 + w2 ) * TWO_M53;
+			x = u * z.mX[layer];
+			if ( u < z.mRatio[layer] ) {
+				// inside the rectangle
+			}
+			else if ( layer == 0 ) {
+				double a, b;
+				do {
+					a = -std::log( 1.0 - Unit() ) / r;
+					b = -std::log( 1.0 - Unit() );
+				} while( b + b <= a * a );
+				x = r + a;
+			}
+			else if ( z.mF[layer] + Unit() * ( z.mF[layer + 1] - z.mF[layer] )
+						>= NormalF( x ) ) {
+				continue;
+			}
+			if ( w1 & 128 ) {
+				x = -x;
+			}
+			break;
+		}
+		x = mMean + mSD * x;
+		out[i] = mLog ? std::exp( x ) : x;
+	}
+}
+
+//----------------------------------------------------------------------------
+// Exponential - as for the normal, but with 8 bits of layer and no sign.
+// The tail is just another exponential, shifted by r.
+//----------------------------------------------------------------------------
+
+static void CheckExponential( double mean ) {
+	if ( ! (mean > 0) || mean > DBL_MAX ) {
+		throw Exception( "Exponential mean must be greater than zero" );
+	}
+}
+
+ExponentialDist :: ExponentialDist( RandomStream & rs, double mean )
+		: Distribution( rs ), mMean( mean ) {
+	CheckExponential( mean );
+}
+
+void ExponentialDist :: FillReal( double * out, unsigned int n ) {
+	const Ziggurat & z = ExpZiggurat();
+	for ( unsigned int i = 0; i < n; i++ ) {
+		double x;
+		for ( ; ; ) {
+			unsigned int w1 = Word(), w2 = Word();
+			unsigned int layer = w1 & 255;
+			double u = ( double( w1 >> 11 ) * 4294967296.0 + w2 ) * TWO_M53;
+			x = u * z.mX[layer];
+			if ( u < z.mRatio[layer] ) {
+				break;
+			}
+			else if ( layer == 0 ) {
+				x = z.mX[1] - std::log( 1.0 - Unit() );
+				break;
+			}
+			else if ( z.mF[layer] + Unit() * ( z.mF[layer + 1] - z.mF[layer] )
+						< ExpF( x ) ) {
+				break;
+			}
+		}
+		out[i] = mMean * x;
+	}
+}
+
+//----------------------------------------------------------------------------
+// Poisson - weights are worked out as logs to avoid overflow
+//----------------------------------------------------------------------------
+
+static void CheckPoisson( double mean ) {
+	if ( ! (mean > 0) || mean > 1e9 ) {
+		throw Exception( "Poisson mean must be greater than zero"
+							" and no more than 1e9" );
+	}
+}
+
+PoissonDist :: PoissonDist( RandomStream & rs, double mean )
+		: Distribution( rs ) {
+	CheckPoisson( mean );
+	double spread = 12 * std::sqrt( mean ) + 12;
+	mLow = std::floor( mean - spread );
+	if ( mLow < 0 ) {
+		mLow = 0;
+	}
+	unsigned int n = (unsigned int)( std::ceil( mean + spread ) - mLow ) + 1;
+	vector <double> w( n );
+	double lm = std::log( mean );
+	for ( unsigned int i = 0; i < n; i++ ) {
+		double k = mLow + i;
+		w[i] = std::exp( k * lm - mean - ::lgamma( k + 1 ) );
+	}
+	mTable.Build( w );
+}
+
+void PoissonDist :: FillReal( double * out, unsigned int n ) {
+	FillUnit( out, n );
+	for ( unsigned int i = 0; i < n; i++ ) {
+		out[i] = mLow + mTable.Pick( out[i] );
+	}
+}
+
+//----------------------------------------------------------------------------
+// Distribution specs
+//----------------------------------------------------------------------------
+
+const char * const NORMAL_DIST		= "normal";
+const char * const LOGNORMAL_DIST	= "lognormal";
+const char * const EXP_DIST		= "exponential";
+const char * const POISSON_DIST	= "poisson";
+
+DistSpec :: DistSpec() : mMean( 0 ), mSD( 0 ) {
+}
+
+//----------------------------------------------------------------------------
+// The parameters are checked as the distribution would check them, so bad
+// ones are reported without having to make a distribution
+//----------------------------------------------------------------------------
+
+DistSpec :: DistSpec( const string & name, double mean, double sd )
+		: mName( name ), mMean( mean ), mSD( sd ) {
+	if ( ! ValidName( name ) ) {
+		throw Exception( "Unknown distribution: " + name );
+	}
+	if ( HasSD( name ) ) {
+		CheckNormal( mean, sd );
+	}
+	else if ( name == EXP_DIST ) {
+		CheckExponential( mean );
+	}
+	else {
+		CheckPoisson( mean );
+	}
 }
 
-UniformDist :: ~UniformDist() {
-	delete mImpl;
+bool DistSpec :: Empty() const {
+	return mName == "";
 }
 
-double UniformDist ::NextReal() {
-	RNG::Randomise();
-	return mImpl->Next();
+bool DistSpec :: HasSD( const string & name ) {
+	return name == NORMAL_DIST || name == LOGNORMAL_DIST;
 }
 
-int UniformDist ::NextInt() {
-	RNG::Randomise();
-	return int( mImpl->Next() );
+bool DistSpec :: ValidName( const string & name ) {
+	return name == NORMAL_DIST || name == LOGNORMAL_DIST
+			|| name == EXP_DIST || name == POISSON_DIST;
 }
 
+//----------------------------------------------------------------------------
+// Caller owns the distribution
+//----------------------------------------------------------------------------
 
+Distribution * DistSpec :: Make( RandomStream & rs ) const {
+	if ( mName == NORMAL_DIST ) {
+		return new NormalDist( rs, mMean, mSD );
+	}
+	else if ( mName == LOGNORMAL_DIST ) {
+		return new NormalDist( rs, mMean, mSD, true );
+	}
+	else if ( mName == EXP_DIST ) {
+		return new ExponentialDist( rs, mMean );
+	}
+	else if ( mName == POISSON_DIST ) {
+		return new PoissonDist( rs, mMean );
+	}
+	throw Exception( "No distribution specified" );
+}
 
 //----------------------------------------------------------------------------
 
 } // namespace
 
+//----------------------------------------------------------------------------
+// Testing
+//----------------------------------------------------------------------------
+
+#ifdef DMK_TEST
+
+#include "a_myth.h"
+#include <set>
+using namespace ALib;
+using namespace DMK;
+
+DEFSUITE( "Random" );
+
+// known answers from the Philox reference implementation
+DEFTEST( Philox ) {
+	unsigned int out[4];
+	unsigned int c1[4] = { 0, 0, 0, 0 }, k1[2] = { 0, 0 };
+	RandomStream::Block( c1, k1, out );
+	FAILNE( out[0], 0x6627e8d5U );
+	FAILNE( out[3], 0x9b00dbd8U );
+	unsigned int c2[4] = { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 };
+	unsigned int k2[2] = { 0xa4093822, 0x299f31d0 };
+	RandomStream::Block( c2, k2, out );
+	FAILNE( out[0], 0xd16cfe09U );
+	FAILNE( out[1], 0x94fdccebU );
+	FAILNE( out[2], 0x5001e420U );
+	FAILNE( out[3], 0x24126ea1U );
+}
+
+// seeking anywhere gives the same values as stepping there
+DEFTEST( Seek ) {
+	RandomStream rs( 42 );
+	std::vector <unsigned int> v;
+	for ( unsigned int i = 0; i < 20; i++ ) {
+		v.push_back( rs() );
+	}
+	for ( unsigned int i = 0; i < 20; i++ ) {
+		rs.Seek( i );
+		FAILNE( rs(), v[i] );
+		FAILNE( rs.Tell(), i + 1 );
+	}
+	rs.Substream( 1 );
+	FAILEQ( rs(), v[0] );
+	rs.Substream( 0 );
+	FAILNE( rs(), v[0] );
+	RandomStream other( 43 );
+	FAILEQ( other(), v[0] );
+}
+
+// bulk values must be the same as values one at a time, and the vector
+// kernels the same as the plain ones
+DEFTEST( Bulk ) {
+	RandomStream r1( 99 ), r2( 99 );
+	r1();
+	r2();
+	std::vector <unsigned int> v( 37 );
+	r1.Fill( &v[0], v.size() );
+	for ( unsigned int i = 0; i < v.size(); i++ ) {
+		FAILNE( v[i], r2() );
+	}
+	std::vector <unsigned int> b1( 4 * 13 ), b2( 4 * 13 );
+	PhiloxScalar( 0xFFFFFFFEULL, 3, 12345, &b1[0], 13 );
+	Kernels().mPhilox( 0xFFFFFFFEULL, 3, 12345, &b2[0], 13 );
+	FAILNE( b1 == b2, true );
+	std::vector <double> u1( 26 ), u2( 26 );
+	UnitScalar( &b1[0], &u1[0], 26, -5.0, 10.0 );
+	Kernels().mUnit( &b1[0], &u2[0], 26, -5.0, 10.0 );
+	FAILNE( u1 == u2, true );
+	UnitScalar( &b1[0], &u1[0], 26, 0.0, 1.0 );
+	u2 = u1;
+	TriangleScalar( &u1[0], 26, 1.0, 2.0, 5.0 );
+	Kernels().mTriangle( &u2[0], 26, 1.0, 2.0, 5.0 );
+	FAILNE( u1 == u2, true );
+}
+
+DEFTEST( Dists ) {
+	RandomStream r1( 5 ), r2( 5 );
+	UniformDist d1( r1, 10, 20 ), d2( r2, 10, 20 );
+	TriangleDist t1( r1, 0, 1, 4 ), t2( r2, 0, 1, 4 );
+	std::vector <double> v( 100 );
+	std::vector <int> t( 100 );
+	d1.FillReal( &v[0], 100 );
+	t1.FillInt( &t[0], 100 );
+	for ( unsigned int i = 0; i < 100; i++ ) {
+		FAILNE( v[i], d2.NextReal() );
+		FAILEQ( v[i] < 10 || v[i] >= 20, true );
+	}
+	for ( unsigned int i = 0; i < 100; i++ ) {
+		FAILNE( t[i], t2.NextInt() );
+		FAILEQ( t[i] < 0 || t[i] >= 4, true );
+	}
+}
+
+// rank frequencies must follow 1 / k^s, over huge ranges too
+DEFTEST( Zipf ) {
+	RandomStream r1( 3 ), r2( 3 );
+	ZipfDist z1( r1, 10, 1.1 ), z2( r2, 10, 1.1 );
+	std::vector <double> v( 100000 );
+	z1.FillReal( &v[0], v.size() );
+	std::vector <int> counts( 11 );
+	for ( unsigned int i = 0; i < v.size(); i++ ) {
+		FAILNE( v[i], z2.NextReal() );
+		FAILEQ( v[i] < 1 || v[i] > 10 || v[i] != std::floor( v[i] ), true );
+		counts[ int( v[i] ) ]++;
+	}
+	double sum = 0;
+	for ( unsigned int k = 1; k <= 10; k++ ) {
+		sum += std::pow( k, -1.1 );
+	}
+	for ( unsigned int k = 1; k <= 10; k++ ) {
+		double expect = v.size() * std::pow( k, -1.1 ) / sum;
+		FAILEQ( std::fabs( counts[k] - expect ) > 5 * std::sqrt( expect ), true );
+	}
+	ZipfDist big( r1, 1e12, 0.8 );
+	double x = 0;
+	for ( unsigned int i = 0; i < 1000; i++ ) {
+		double k = big.NextReal();
+		FAILEQ( k < 1 || k > 1e12, true );
+		if ( k > x ) {
+			x = k;
+		}
+	}
+	FAILNE( x > 1e9, true );
+}
+
+// sample moments must be close to the real ones, and batches must match
+// single draws even when values are rejected
+static void Moments( Distribution & d, unsigned int n,
+						double & mean, double & sd ) {
+	std::vector <double> v( n );
+	d.FillReal( &v[0], n );
+	double sum = 0, sq = 0;
+	for ( unsigned int i = 0; i < n; i++ ) {
+		sum += v[i];
+		sq += v[i] * v[i];
+	}
+	mean = sum / n;
+	sd = std::sqrt( sq / n - mean * mean );
+}
+
+DEFTEST( Ziggurat ) {
+	RandomStream r1( 9 ), r2( 9 );
+	NormalDist n1( r1, 0, 1 ), n2( r2, 0, 1 );
+	std::vector <double> v( 200000 );
+	n1.FillReal( &v[0], v.size() );
+	unsigned int tail = 0;
+	for ( unsigned int i = 0; i < v.size(); i++ ) {
+		FAILNE( v[i], n2.NextReal() );
+		tail += std::fabs( v[i] ) > 3;
+	}
+	FAILEQ( tail < 440 || tail > 640, true );		// expect 540
+
+	double mean, sd;
+	NormalDist nd( r1, 10, 2 );
+	Moments( nd, 100000, mean, sd );
+	FAILEQ( std::fabs( mean - 10 ) > 0.03 || std::fabs( sd - 2 ) > 0.03, true );
+	ExponentialDist ed( r1, 5 );
+	Moments( ed, 100000, mean, sd );
+	FAILEQ( std::fabs( mean - 5 ) > 0.1 || std::fabs( sd - 5 ) > 0.1, true );
+	PoissonDist pd( r1, 4 );
+	Moments( pd, 100000, mean, sd );
+	FAILEQ( std::fabs( mean - 4 ) > 0.03 || std::fabs( sd - 2 ) > 0.03, true );
+	PoissonDist big( r1, 1e6 );
+	Moments( big, 10000, mean, sd );
+	FAILEQ( std::fabs( mean - 1e6 ) > 50 || std::fabs( sd - 1e3 ) > 50, true );
+	NormalDist ld( r1, 1, 0.5, true );
+	Moments( ld, 100000, mean, sd );
+	FAILEQ( std::fabs( mean - std::exp( 1.125 ) ) > 0.05, true );
+}
+
+// picks must follow the weights, and never pick a zero weight
+DEFTEST( Alias ) {
+	vector <double> w;
+	w.push_back( 1 );
+	w.push_back( 0 );
+	w.push_back( 3 );
+	w.push_back( 0.5 );
+	AliasTable at( w );
+	FAILNE( at.Size(), 4 );
+	RandomStream rs( 11 );
+	vector <int> counts( 4 );
+	for ( unsigned int i = 0; i < 45000; i++ ) {
+		counts[ at.Pick( rs ) ]++;
+	}
+	FAILNE( counts[1], 0 );
+	FAILEQ( counts[0] < 9500 || counts[0] > 10500, true );
+	FAILEQ( counts[2] < 29000 || counts[2] > 31000, true );
+	FAILEQ( counts[3] < 4500 || counts[3] > 5500, true );
+	w.assign( 3, 0.0 );
+	bool ok = false;
+	try {
+		at.Build( w );
+	}
+	catch( const DMK::Exception & ) {
+		ok = true;
+	}
+	FAILNE( ok, true );
+}
+
+// no modulo bias - with n of 3 * 2^30, taking the stream value mod n
+// would give values below 2^30 half the time, rather than a third
+DEFTEST( Below ) {
+	RandomStream r1( 21 ), r2( 21 );
+	const unsigned int big = 3u << 30;
+	std::vector <unsigned int> v( 30000 );
+	r1.FillBelow( big, &v[0], v.size() );
+	unsigned int low = 0;
+	for ( unsigned int i = 0; i < v.size(); i++ ) {
+		FAILNE( v[i], r2.Below( big ) );
+		low += v[i] < ( 1u << 30 );
+	}
+	FAILEQ( low < 9500 || low > 10500, true );
+	FAILNE( r1.Tell(), r2.Tell() );
+	for ( unsigned int i = 0; i < 1000; i++ ) {
+		FAILEQ( r1.Below( 7 ) >= 7, true );
+	}
+	FAILNE( r1.Below( 1 ), 0 );
+	RandomStream r3( 5 ), r4( 5 );
+	for ( unsigned int i = 0; i < 100; i++ ) {
+		FAILNE( r3.Below64( 1000 ), r4.Below( 1000 ) );
+	}
+	const unsigned long long huge = 3ULL << 62;
+	unsigned int top = 0;
+	for ( unsigned int i = 0; i < 3000; i++ ) {
+		unsigned long long x = r3.Below64( huge );
+		FAILEQ( x >= huge, true );
+		top += x >= ( 1ULL << 63 );
+	}
+	FAILEQ( top < 900 || top > 1100, true );
+}
+
+// every index appears once, and different keys give different orders
+DEFTEST( Permute ) {
+	const unsigned long long sizes[] = { 1, 2, 3, 10, 1000, 65537 };
+	for ( unsigned int s = 0; s < 6; s++ ) {
+		Permutation p( sizes[s], 99 );
+		FAILNE( p.Size(), sizes[s] );
+		std::vector <char> seen( sizes[s] );
+		for ( unsigned long long i = 0; i < sizes[s]; i++ ) {
+			unsigned long long x = p.At( i );
+			FAILEQ( x >= sizes[s], true );
+			FAILNE( (int) seen[x], 0 );
+			seen[x] = 1;
+		}
+	}
+	Permutation p1( 1000, 1 ), p2( 1000, 2 );
+	unsigned int same = 0, fixed = 0;
+	for ( unsigned int i = 0; i < 1000; i++ ) {
+		same += p1.At( i ) == p2.At( i );
+		fixed += p1.At( i ) == i;
+	}
+	FAILEQ( same > 10 || fixed > 10, true );
+	Permutation big( 5000000000ULL, 3 );
+	FAILEQ( big.At( 4999999999ULL ) >= 5000000000ULL, true );
+}
+
+DEFTEST( UniqueStrings ) {
+	vector <string> sets;
+	sets.push_back( "ab" );
+	sets.push_back( "-" );
+	sets.push_back( "0123456789" );
+	UniqueStrings us( sets );
+	FAILNE( us.Size(), 20 );
+	RandomStream rs( 5 );
+	std::set <string> seen;
+	for ( unsigned int i = 0; i < 20; i++ ) {
+		string s = us.Next( rs );
+		FAILNE( s.size(), 3 );
+		FAILNE( s[1], '-' );
+		seen.insert( s );
+	}
+	FAILNE( seen.size(), 20 );
+	bool threw = false;
+	try {
+		us.Next( rs );
+	}
+	catch( const DMK::Exception & ) {
+		threw = true;
+	}
+	FAILNE( threw, true );
+
+	// too many strings to count through - the first set is left random
+	vector <string> big( 20, "0123456789" );
+	UniqueStrings ub( big );
+	FAILNE( ub.Size(), 10000000000000000000ULL );
+	FAILNE( ub.Next( rs ).size(), 20 );
+}
+
+DEFTEST( Range ) {
+	RandomStream rs( 7 );
+	for ( unsigned int i = 0; i < 1000; i++ ) {
+		int n = rs.Random( -3, 4 );
+		FAILEQ( n < -3 || n >= 4, true );
+		double d = rs.Real();
+		FAILEQ( d < 0.0 || d >= 1.0, true );
+	}
+}
+
+#endif
+
+//----------------------------------------------------------------------------
 
 // end
 
@@ -2,7 +2,9 @@
 // dmk_row.cpp
 //
 // A row is the basic DMK data structure, passed around between data sources
-// and filters. As it is copied a lot, we make it reference counted.
+// and filters. All the values in a row are held in one flat block, which is
+// inline for short rows and reference counted on the heap for longer ones.
+// Numeric and temporal values are held natively and formatted on demand.
 //
 // Copyright (C) 2009 Neil Butterworth
 //---------------------------------------------------------------------------
@@ -10,8 +12,15 @@
 #include "a_base.h"
 #include "a_csv.h"
 #include "dmk_row.h"
-#include <iostream>
 #include "dmk_fieldlist.h"
+#include "dmk_quote.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <new>
 
 using std::string;
 using std::vector;
@@ -23,7 +32,82 @@ namespace DMK {
 //#define DMK_ROW_DEBUG			// turns debug output on/off
 
 //----------------------------------------------------------------------------
-// This class provides the actual reference counted representation for rows.
+// Helpers for the flat block layout - header, then field end offsets with
+// a leading zero, then a type byte per field, then the field data itself.
+// The low bits of a type byte are the CellType, the high bits the number
+// of decimal places for reals.
+//----------------------------------------------------------------------------
+
+static inline unsigned int * Offsets( RowBlock * b ) {
+	return reinterpret_cast <unsigned int *>( b + 1 );
+}
+
+static inline unsigned char * Types( RowBlock * b ) {
+	return reinterpret_cast <unsigned char *>( Offsets( b ) + b->mFieldCap + 1 );
+}
+
+static inline char * Bytes( RowBlock * b ) {
+	return reinterpret_cast <char *>( Types( b ) + b->mFieldCap );
+}
+
+// space needed by a block able to hold the specified fields & bytes
+static inline unsigned int BlockSpace( unsigned int fields,
+										unsigned int bytes ) {
+	return sizeof( RowBlock ) + (fields + 1) * sizeof( unsigned int )
+				+ fields + bytes;
+}
+
+const unsigned char CELL_TYPE_MASK = 0x0f;
+const unsigned int CELL_PLACES_SHIFT = 4;
+
+// space actually in use, which is all that needs copying
+static inline unsigned int UsedSpace( RowBlock * b ) {
+	return (Bytes( b ) - reinterpret_cast <char *>( b )) + b->mBytes;
+}
+
+// set up empty block using all available space
+static void InitBlock( RowBlock * b, unsigned int space,
+						unsigned int fieldcap ) {
+	b->mFields = 0;
+	b->mBytes = 0;
+	b->mFieldCap = fieldcap;
+	b->mByteCap = space - BlockSpace( fieldcap, 0 );
+	Offsets( b )[0] = 0;
+}
+
+// copy contents of one block to another, which must be big enough
+static void CopyBlock( RowBlock * to, RowBlock * from ) {
+	std::memcpy( Offsets( to ), Offsets( from ),
+					(from->mFields + 1) * sizeof( unsigned int ) );
+	std::memcpy( Types( to ), Types( from ), from->mFields );
+	std::memcpy( Bytes( to ), Bytes( from ), from->mBytes );
+	to->mFields = from->mFields;
+	to->mBytes = from->mBytes;
+}
+
+//----------------------------------------------------------------------------
+// Segments of a row built by AppendRef - the parts are always flat rows.
+//----------------------------------------------------------------------------
+
+struct RowParts {
+
+	RowParts() : mFields( 0 ) {}
+
+	void Add( const Row & r ) {
+		mStarts.push_back( mFields );
+		mRows.push_back( r );
+		mFields += r.Size();
+	}
+
+	Rows mRows;
+	vector <unsigned int> mStarts;		// index of first field in each part
+	unsigned int mFields;
+};
+
+//----------------------------------------------------------------------------
+// This class provides the reference counted heap representation for rows
+// that don't fit inline. The block is allocated along with the rep. If the
+// row is segmented, the block is empty and the parts hold the data.
 // DMK is resolutely single-threaded so there are no synch issues here.
 //----------------------------------------------------------------------------
 
@@ -31,45 +115,40 @@ class RowRep {
 
 	public:
 
-		RowRep() : mRefCount(1) {
+		static RowRep * Create( unsigned int space ) {
+			void * p = std::malloc( sizeof( RowRep ) - sizeof( RowBlock ) + space );
+			if ( p == 0 ) {
+				throw std::bad_alloc();
+			}
 #ifdef DMK_ROW_DEBUG
 			std::cout << "Rep ctor count: " << ++mInstCount << std::endl;
 #endif
+			RowRep * r = static_cast <RowRep *>( p );
+			r->mRefCount = 1;
+			r->mSpace = space;
+			r->mParts = 0;
+			return r;
 		}
 
-		~RowRep() {
+		static RowRep * Create( RowParts * parts ) {
+			RowRep * r = Create( BlockSpace( 0, 0 ) );
+			InitBlock( &r->mBlock, r->mSpace, 0 );
+			r->mParts = parts;
+			return r;
+		}
+
+		static void Destroy( RowRep * r ) {
 #ifdef DMK_ROW_DEBUG
 			std::cout << "Rep dtor count: " << --mInstCount << std::endl;
 #endif
+			delete r->mParts;
+			std::free( r );
 		}
 
-		unsigned int RefCount() const {
-			return mRefCount;
-		}
-
-		unsigned int IncRefCount() {
-			return ++mRefCount;
-		}
-
-		unsigned int DecRefCount() {
-			return --mRefCount;
-		}
-
-		vector<string> & Values()  {
-			return mValues;
-		}
-
-		static RowRep * Copy( RowRep * p ) {
-			p->mRefCount--;
-			RowRep * tmp = new RowRep;
-			tmp->mValues = p->mValues;
-			return tmp;
-		}
-
-	private:
-
 		unsigned int mRefCount;
-		vector <string> mValues;
+		unsigned int mSpace;
+		RowParts * mParts;
+		RowBlock mBlock;			// must be last
 		static int mInstCount;
 };
 
@@ -80,14 +159,14 @@ int RowRep::mInstCount = 0;
 int Row::mInstCount = 0;
 
 //----------------------------------------------------------------------------
-// Default ctor creates row with no columns.
+// Default ctor creates row with no columns, stored inline.
 //----------------------------------------------------------------------------
 
 Row :: Row() : mRep ( 0 ) {
 #ifdef DMK_ROW_DEBUG
 	std::cout << "Row ctor count: " << ++mInstCount << std::endl;
 #endif
-	mRep = new RowRep;
+	InitBlock( &mHead, INLINE_SIZE, 4 );
 }
 
 //----------------------------------------------------------------------------
@@ -98,9 +177,116 @@ Row :: ~Row() {
 #ifdef DMK_ROW_DEBUG
 	std::cout << "Row dtor count: " << --mInstCount << std::endl;
 #endif
-	if ( mRep->DecRefCount() == 0 ) {
-		delete mRep;
+	Release();
+}
+
+//----------------------------------------------------------------------------
+// Give up any heap rep we are using.
+//----------------------------------------------------------------------------
+
+void Row :: Release() {
+	if ( mRep && --mRep->mRefCount == 0 ) {
+		RowRep::Destroy( mRep );
+	}
+	mRep = 0;
+}
+
+//----------------------------------------------------------------------------
+// Where the row data is and how much room it has
+//----------------------------------------------------------------------------
+
+RowBlock * Row :: Block() const {
+	return mRep ? &mRep->mBlock : const_cast <RowBlock *>( &mHead );
+}
+
+unsigned int Row :: Space() const {
+	return mRep ? mRep->mSpace : (unsigned int) INLINE_SIZE;
+}
+
+unsigned int Row :: ByteCount() const {
+	if ( Segmented() ) {
+		unsigned int n = 0;
+		for ( unsigned int i = 0; i < mRep->mParts->mRows.size(); i++ ) {
+			n += mRep->mParts->mRows[i].Block()->mBytes;
+		}
+		return n;
+	}
+	return Block()->mBytes;
+}
+
+//----------------------------------------------------------------------------
+// Is this a row made up of segments? Parts of such rows are never
+// themselves segmented.
+//----------------------------------------------------------------------------
+
+bool Row :: Segmented() const {
+	return mRep && mRep->mParts;
+}
+
+//----------------------------------------------------------------------------
+// Are we the only user of the row storage?
+//----------------------------------------------------------------------------
+
+bool Row :: Unique() const {
+	return mRep == 0 || mRep->mRefCount == 1;
+}
+
+//----------------------------------------------------------------------------
+// Get the part of a segmented row containing field i, changing i to be
+// the index within the part.
+//----------------------------------------------------------------------------
+
+const Row & Row :: Part( unsigned int & i ) const {
+	RowParts * p = mRep->mParts;
+	if ( i >= p->mFields ) {
+		throw Exception( "Invalid column in Row::At" );
+	}
+	unsigned int n = std::upper_bound( p->mStarts.begin(),
+								p->mStarts.end(), i ) - p->mStarts.begin() - 1;
+	i -= p->mStarts[n];
+	return p->mRows[n];
+}
+
+//----------------------------------------------------------------------------
+// Make this row segmented, if it is not already, and make sure we are the
+// only user of the segment list, which is returned. Any existing contents
+// become the first segment.
+//----------------------------------------------------------------------------
+
+RowParts * Row :: Segments() {
+	RowParts * p = 0;
+	if ( Segmented() ) {
+		if ( mRep->mRefCount == 1 ) {
+			return mRep->mParts;
+		}
+		p = new RowParts( * mRep->mParts );
+	}
+	else {
+		p = new RowParts;
+		if ( Size() ) {
+			p->Add( *this );
+		}
+	}
+	Release();
+	mRep = RowRep::Create( p );
+	return p;
+}
+
+//----------------------------------------------------------------------------
+// Convert segmented row to a single flat block
+//----------------------------------------------------------------------------
+
+void Row :: Flatten() {
+	if ( ! Segmented() ) {
+		return;
 	}
+	RowParts * p = mRep->mParts;
+	Row r;
+	r.Reserve( p->mFields, ByteCount() );
+	for ( unsigned int i = 0; i < p->mRows.size(); i++ ) {
+		r.AppendRow( p->mRows[i] );
+	}
+	*this = r;
 }
 
 //----------------------------------------------------------------------------
@@ -108,20 +294,29 @@ Row :: ~Row() {
 //----------------------------------------------------------------------------
 
 Row :: Row( const string & csv ) : mRep ( 0 ){
-	mRep = new RowRep;
+	InitBlock( &mHead, INLINE_SIZE, 4 );
+	Strings vals;
 	ALib::CSVLineParser lp;
-	lp.Parse( csv, mRep->Values() );
+	lp.Parse( csv, vals );
+	AppendStrings( vals );
 #ifdef DMK_ROW_DEBUG
 	std::cout << "Row ctor count: " << ++mInstCount << std::endl;
 #endif
 }
 
 //----------------------------------------------------------------------------
-// ctor - Copy a row by incrementing ref count
+// ctor - Copy a row by incrementing ref count or, if inline, by copying
+// the used part of the inline block.
 //----------------------------------------------------------------------------
 
 Row :: Row( const Row & row ) : mRep( row.mRep ) {
-	mRep->IncRefCount();
+	if ( mRep ) {
+		mRep->mRefCount++;
+	}
+	else {
+		std::memcpy( mInline, row.mInline,
+						UsedSpace( const_cast <RowBlock *>( &row.mHead ) ) );
+	}
 #ifdef DMK_ROW_DEBUG
 	std::cout << "Row ctor count: " << ++mInstCount << std::endl;
 #endif
@@ -133,22 +328,70 @@ Row :: Row( const Row & row ) : mRep( row.mRep ) {
 //----------------------------------------------------------------------------
 
 Row & Row :: operator = ( const Row & row ) {
-	if ( row.mRep  != this->mRep ) {
-		if ( mRep->DecRefCount() == 0 ) {
-			delete mRep;
-		}
+	if ( &row == this ) {
+		return *this;
+	}
+	if ( row.mRep ) {
+		row.mRep->mRefCount++;
+		Release();
 		mRep = row.mRep;
-		mRep->IncRefCount();
+	}
+	else {
+		Release();
+		std::memcpy( mInline, row.mInline,
+						UsedSpace( const_cast <RowBlock *>( &row.mHead ) ) );
 	}
 	return *this;
 }
 
+//----------------------------------------------------------------------------
+// Make sure we are the only user of the row storage and that it has room
+// for the specified total numbers of fields and bytes. If the current
+// block has enough space it is re-laid out in place, otherwise we move to
+// a new heap block, growing geometrically to keep appends cheap.
+//----------------------------------------------------------------------------
+
+void Row :: Reserve( unsigned int fields, unsigned int bytes ) {
+	Flatten();
+	RowBlock * b = Block();
+	bool shared = mRep && mRep->mRefCount > 1;
+	if ( ! shared && b->mFieldCap >= fields && b->mByteCap >= bytes ) {
+		return;
+	}
+
+	unsigned int fc = std::max( fields, b->mFieldCap );
+	unsigned int bc = std::max( bytes, b->mBytes );
+
+	if ( ! shared && BlockSpace( fc, bc ) <= Space() ) {
+		if ( fc != b->mFieldCap ) {
+			char * old = Bytes( b );
+			unsigned char * oldtypes = Types( b );
+			b->mFieldCap = fc;
+			std::memmove( Bytes( b ), old, b->mBytes );
+			std::memmove( Types( b ), oldtypes, b->mFields );
+			b->mByteCap = Space() - BlockSpace( fc, 0 );
+		}
+		return;
+	}
+
+	if ( ! shared ) {
+		fc = std::max( fc, b->mFieldCap * 2 );
+		bc = std::max( bc, b->mByteCap * 2 );
+	}
+	unsigned int space = BlockSpace( fc, bc );
+	RowRep * rep = RowRep::Create( space );
+	InitBlock( &rep->mBlock, space, fc );
+	CopyBlock( &rep->mBlock, b );
+	Release();
+	mRep = rep;
+}
+
 //----------------------------------------------------------------------------
 // Access row as vector. Note rows are immutable via this interface.
 //----------------------------------------------------------------------------
 
 unsigned int Row :: Size() const {
-	return mRep->Values().size();
+	return Segmented() ? mRep->mParts->mFields : Block()->mFields;
 }
 
 //----------------------------------------------------------------------------
@@ -156,19 +399,175 @@ unsigned int Row :: Size() const {
 //----------------------------------------------------------------------------
 
 bool Row :: IsEmpty() const {
-	return mRep->Values().size() == 0;
+	return Size() == 0;
+}
+
+//----------------------------------------------------------------------------
+// Format a typed field into a buffer, returning the length of the text.
+// The buffer must be big enough for any real (DBL_MAX has 309 digits).
+//----------------------------------------------------------------------------
+
+const unsigned int FORMAT_SIZE = 400;
+
+static long long IntValue( const Row & r, unsigned int i ) {
+	long long n;
+	std::memcpy( &n, r.Data( i ), sizeof( n ) );
+	return n;
+}
+
+static double RealValue( const Row & r, unsigned int i ) {
+	if ( r.Type( i ) != CELL_REAL ) {
+		return double( IntValue( r, i ) );
+	}
+	double d;
+	std::memcpy( &d, r.Data( i ), sizeof( d ) );
+	return d;
 }
 
 //----------------------------------------------------------------------------
-// Do all access via at() to get range checking.
+// Integers, dates and times are formatted by hand two digits at a time, as
+// sprintf is a large part of the cost of output. Out of range dates and
+// times, and all reals, still use sprintf.
 //----------------------------------------------------------------------------
 
-const string & Row :: operator[] ( unsigned int  i ) const {
+static const char DIGIT_PAIRS[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233"
+	"34353637383940414243444546474849505152535455565758596061626364656667"
+	"6869707172737475767778798081828384858687888990919293949596979899";
+
+static char * TwoDigits( char * p, unsigned int n ) {
+	std::memcpy( p, DIGIT_PAIRS + 2 * n, 2 );
+	return p + 2;
+}
+
+static unsigned int FormatInt( long long n, char * buf ) {
+	char tmp[24];
+	char * p = tmp + sizeof( tmp );
+	unsigned long long u = n < 0 ? 0ULL - (unsigned long long) n : n;
+	while( u >= 100 ) {
+		p -= 2;
+		TwoDigits( p, unsigned( u % 100 ) );
+		u /= 100;
+	}
+	if ( u >= 10 ) {
+		p -= 2;
+		TwoDigits( p, unsigned( u ) );
+	}
+	else {
+		*--p = char( '0' + u );
+	}
+	if ( n < 0 ) {
+		*--p = '-';
+	}
+	unsigned int len = tmp + sizeof( tmp ) - p;
+	std::memcpy( buf, p, len );
+	return len;
+}
+
+static unsigned int FormatDate( int d, char * buf ) {
+	if ( d < 0 || d > 99991231 ) {
+		return std::sprintf( buf, "%04d-%02d-%02d",
+								d / 10000, (d / 100) % 100, d % 100 );
+	}
+	char * p = TwoDigits( buf, d / 1000000 );
+	p = TwoDigits( p, (d / 10000) % 100 );
+	*p++ = '-';
+	p = TwoDigits( p, (d / 100) % 100 );
+	*p++ = '-';
+	TwoDigits( p, d % 100 );
+	return 10;
+}
+
+static unsigned int FormatTime( int secs, char * buf ) {
+	int hrs = secs / (60 * 60);
+	int mins = (secs - hrs * 60 * 60) / 60;
+	if ( secs < 0 || hrs > 99 ) {
+		return std::sprintf( buf, "%02d:%02d:%02d", hrs, mins, secs % 60 );
+	}
+	char * p = TwoDigits( buf, hrs );
+	*p++ = ':';
+	p = TwoDigits( p, mins );
+	*p++ = ':';
+	TwoDigits( p, secs % 60 );
+	return 8;
+}
+
+static unsigned int FormatCell( const Row & r, unsigned int i, char * buf ) {
+	switch( r.Type( i ) ) {
+		case CELL_INT:
+			return FormatInt( IntValue( r, i ), buf );
+		case CELL_REAL:
+			return std::sprintf( buf, "%.*f", r.Places( i ), RealValue( r, i ) );
+		case CELL_DATE:
+			return FormatDate( int( IntValue( r, i ) ), buf );
+		case CELL_TIME:
+			return FormatTime( int( IntValue( r, i ) ), buf );
+		default:
+			throw Exception( "Cannot format text field" );
+	}
+}
+
+//----------------------------------------------------------------------------
+// Do all access via at() to get range checking. Values are returned as
+// copies - use Data() and Length() to get at them without copying. Typed
+// values are formatted here.
+//----------------------------------------------------------------------------
+
+string Row :: operator[] ( unsigned int  i ) const {
 	return At( i );
 }
 
-const string & Row :: At( unsigned int  i ) const {
-	return mRep->Values().at( i );
+string Row :: At( unsigned int  i ) const {
+	if ( Type( i ) == CELL_TEXT ) {
+		return string( Data( i ), Length( i ) );
+	}
+	char buf[ FORMAT_SIZE ];
+	unsigned int n = FormatCell( *this, i, buf );
+	return string( buf, n );
+}
+
+const char * Row :: Data( unsigned int i ) const {
+	if ( Segmented() ) {
+		const Row & r = Part( i );
+		return r.Data( i );
+	}
+	RowBlock * b = Block();
+	if ( i >= b->mFields ) {
+		throw Exception( "Invalid column in Row::At" );
+	}
+	return Bytes( b ) + Offsets( b )[i];
+}
+
+unsigned int Row :: Length( unsigned int i ) const {
+	if ( Segmented() ) {
+		const Row & r = Part( i );
+		return r.Length( i );
+	}
+	RowBlock * b = Block();
+	if ( i >= b->mFields ) {
+		throw Exception( "Invalid column in Row::At" );
+	}
+	return Offsets( b )[i+1] - Offsets( b )[i];
+}
+
+unsigned char Row :: TypeByte( unsigned int i ) const {
+	if ( Segmented() ) {
+		const Row & r = Part( i );
+		return r.TypeByte( i );
+	}
+	RowBlock * b = Block();
+	if ( i >= b->mFields ) {
+		throw Exception( "Invalid column in Row::At" );
+	}
+	return Types( b )[i];
+}
+
+CellType Row :: Type( unsigned int i ) const {
+	return CellType( TypeByte( i ) & CELL_TYPE_MASK );
+}
+
+unsigned int Row :: Places( unsigned int i ) const {
+	return TypeByte( i ) >> CELL_PLACES_SHIFT;
 }
 
 //----------------------------------------------------------------------------
@@ -176,27 +575,101 @@ const string & Row :: At( unsigned int  i ) const {
 //----------------------------------------------------------------------------
 
 void Row :: Erase( unsigned int col ) {
-	if ( col >= mRep->Values().size() ) {
+	if ( col >= Size() ) {
 		throw Exception( "Invalid column in Row::Erase" );
 	}
-	if ( mRep->RefCount() > 1 ) {
-		mRep = RowRep::Copy( mRep );
+	Reserve( Size(), ByteCount() );
+	RowBlock * b = Block();
+	unsigned int * off = Offsets( b );
+	unsigned int len = off[col+1] - off[col];
+	std::memmove( Bytes( b ) + off[col], Bytes( b ) + off[col+1],
+					b->mBytes - off[col+1] );
+	std::memmove( Types( b ) + col, Types( b ) + col + 1,
+					b->mFields - col - 1 );
+	for ( unsigned int i = col + 1; i < b->mFields; i++ ) {
+		off[i] = off[i+1] - len;
 	}
-	mRep->Values().erase( mRep->Values().begin() + col );
+	b->mFields--;
+	b->mBytes -= len;
 }
 
 //----------------------------------------------------------------------------
-// Append a single field
+// Append a single field. The data must not come from this row. Values
+// appended to a segmented row go into its last segment if we are the only
+// user of that, otherwise into a new one.
 //----------------------------------------------------------------------------
 
 Row & Row :: AppendValue( const string & val ) {
-	if ( mRep->RefCount() > 1 ) {
-		mRep = RowRep::Copy( mRep );
+	return AppendCell( val.data(), val.size(), CELL_TEXT );
+}
+
+Row & Row :: AppendValue( const char * data, unsigned int len ) {
+	return AppendCell( data, len, CELL_TEXT );
+}
+
+Row & Row :: AppendCell( const char * data, unsigned int len,
+							unsigned char type ) {
+	if ( Segmented() ) {
+		RowParts * p = Segments();
+		if ( p->mRows.empty() || ! p->mRows.back().Unique() ) {
+			p->Add( Row() );
+		}
+		p->mRows.back().AppendCell( data, len, type );
+		p->mFields++;
+		return *this;
 	}
-	mRep->Values().push_back( val );
+	RowBlock * b = Block();
+	Reserve( b->mFields + 1, b->mBytes + len );
+	b = Block();
+	std::memcpy( Bytes( b ) + b->mBytes, data, len );
+	b->mBytes += len;
+	Types( b )[ b->mFields ] = type;
+	Offsets( b )[ ++b->mFields ] = b->mBytes;
 	return *this;
 }
 
+//----------------------------------------------------------------------------
+// Append typed values, which are stored natively. Dates and times are
+// held as integers so they compare correctly.
+//----------------------------------------------------------------------------
+
+Row & Row :: AppendInt( long long n ) {
+	return AppendCell( reinterpret_cast <const char *>( &n ),
+							sizeof( n ), CELL_INT );
+}
+
+Row & Row :: AppendReal( double d, unsigned int places ) {
+	if ( places > (0xff >> CELL_PLACES_SHIFT) ) {
+		throw Exception( "Too many decimal places in Row::AppendReal" );
+	}
+	return AppendCell( reinterpret_cast <const char *>( &d ), sizeof( d ),
+							CELL_REAL | (places << CELL_PLACES_SHIFT) );
+}
+
+Row & Row :: AppendDate( int year, int month, int day ) {
+	long long n = year * 10000LL + month * 100 + day;
+	return AppendCell( reinterpret_cast <const char *>( &n ),
+							sizeof( n ), CELL_DATE );
+}
+
+Row & Row :: AppendTime( int secs ) {
+	long long n = secs;
+	return AppendCell( reinterpret_cast <const char *>( &n ),
+							sizeof( n ), CELL_TIME );
+}
+
+//----------------------------------------------------------------------------
+// Append a single field of another row, keeping its type
+//----------------------------------------------------------------------------
+
+Row & Row :: AppendField( const Row & row, unsigned int i ) {
+	if ( &row == this ) {
+		Row tmp( row );
+		return AppendField( tmp, i );
+	}
+	return AppendCell( row.Data( i ), row.Length( i ), row.TypeByte( i ) );
+}
+
 //----------------------------------------------------------------------------
 // Append from string containing CSV values, ach value becomes a new field
 //----------------------------------------------------------------------------
@@ -212,50 +685,249 @@ Row & Row :: AppendCSV( const string & csv ) {
 //----------------------------------------------------------------------------
 
 Row & Row :: AppendStrings( const Strings & s ) {
-	if ( mRep->RefCount() > 1 ) {
-		mRep = RowRep::Copy( mRep );
+	unsigned int bytes = 0;
+	for ( unsigned int i = 0; i < s.size(); i++ ) {
+		bytes += s[i].size();
+	}
+	if ( ! Segmented() ) {
+		Reserve( Size() + s.size(), ByteCount() + bytes );
 	}
 	for ( unsigned int i = 0; i < s.size(); i++ ) {
-		mRep->Values().push_back( s[i] );
+		AppendValue( s[i] );
 	}
 	return *this;
 }
 
 //----------------------------------------------------------------------------
-// Append one row to another. Possibly we are appending to ourself, which is
-// an OK thing to do, though infrequent in DMK code, so no need to be very
-//  efficient!
+// Append one row to another. Possibly we are appending to ourself, in
+// which case we work from a copy, which keeps the source data alive if
+// the storage gets reallocated - the shared storage then also forces
+// Reserve() to move us to a new block. Otherwise the whole block of data
+// is copied in one go and the offsets adjusted.
 //----------------------------------------------------------------------------
 
 Row & Row :: AppendRow( const Row & row ) {
 
-	if ( mRep == row.mRep ) {					// self append
-		vector <string> tmp( mRep->Values() );	// must be from copy
-		for ( unsigned int i = 0; i < tmp.size(); i++ ) {
-			AppendValue( tmp[i] );
+	if ( &row == this ) {
+		Row tmp( row );
+		return AppendRow( tmp );
+	}
+
+	if ( Segmented() ) {
+		RowParts * p = Segments();
+		if ( p->mRows.empty() || ! p->mRows.back().Unique() ) {
+			p->Add( Row() );
 		}
+		p->mRows.back().AppendRow( row );
+		p->mFields += row.Size();
+		return *this;
 	}
-	else {										// normal append
-		for ( unsigned int i = 0; i < row.Size(); i++ ) {
-			AppendValue( row[i] );
+
+	if ( row.Segmented() ) {
+		RowParts * p = row.mRep->mParts;
+		Reserve( Size() + p->mFields, ByteCount() + row.ByteCount() );
+		for ( unsigned int i = 0; i < p->mRows.size(); i++ ) {
+			AppendRow( p->mRows[i] );
 		}
+		return *this;
 	}
+
+	RowBlock * from = row.Block();
+	RowBlock * b = Block();
+	Reserve( b->mFields + from->mFields, b->mBytes + from->mBytes );
+	b = Block();
+
+	std::memcpy( Bytes( b ) + b->mBytes, Bytes( from ), from->mBytes );
+	std::memcpy( Types( b ) + b->mFields, Types( from ), from->mFields );
+	unsigned int * off = Offsets( b ) + b->mFields;
+	unsigned int * foff = Offsets( from );
+	for ( unsigned int i = 1; i <= from->mFields; i++ ) {
+		off[i] = b->mBytes + foff[i];
+	}
+	b->mFields += from->mFields;
+	b->mBytes += from->mBytes;
 	return *this;
 }
 
 //----------------------------------------------------------------------------
-// Return contents as CSV string
+// Append a row without copying its data - the row becomes a segment of
+// this one. Appending to an empty row just shares the appended row, and
+// segmented rows are added as their individual segments, so there is
+// never more than one level of segments.
 //----------------------------------------------------------------------------
 
-string Row :: AsCSV() const {
-	string s;
-	for ( unsigned int i = 0; i < Size(); i++ ) {
-		if ( s.size() > 0 ) {
-			s += ',';
+Row & Row :: AppendRef( const Row & row ) {
+
+	if ( row.IsEmpty() ) {
+		return *this;
+	}
+	else if ( IsEmpty() ) {
+		return *this = row;
+	}
+	else if ( &row == this ) {
+		Row tmp( row );
+		return AppendRef( tmp );
+	}
+
+	RowParts * p = Segments();
+	if ( row.Segmented() ) {
+		RowParts * rp = row.mRep->mParts;
+		for ( unsigned int i = 0; i < rp->mRows.size(); i++ ) {
+			p->Add( rp->mRows[i] );
 		}
-		s += ALib::CSVQuote( At( i ) );
 	}
-	return s;
+	else {
+		p->Add( row );
+	}
+	return *this;
+}
+
+//----------------------------------------------------------------------------
+// Upper bound on the size of a typed field once formatted. Reals that are
+// too large for their integer digits to be counted cheaply use the full
+// format buffer size.
+//----------------------------------------------------------------------------
+
+static unsigned int FormatBound( const Row & r, unsigned int i ) {
+	if ( r.Type( i ) != CELL_REAL ) {
+		return 24;
+	}
+	double d = RealValue( r, i );
+	if ( d < 1e18 && d > -1e18 ) {
+		return 24 + r.Places( i );
+	}
+	return FORMAT_SIZE;
+}
+
+//----------------------------------------------------------------------------
+// Write fields as quoted CSV, walking the segments of segmented rows. Text
+// has any embedded quotes doubled, which is the only escaping CSV needs.
+// Typed values never contain quotes so are formatted straight into the
+// output without being scanned - the extra byte allowed for by CSVSize()
+// takes sprintf's null.
+//----------------------------------------------------------------------------
+
+static unsigned int CSVBound( const Row & row ) {
+	unsigned int n = 0;
+	for ( unsigned int i = 0; i < row.Size(); i++ ) {
+		if ( row.Type( i ) == CELL_TEXT ) {
+			n += 2 * row.Length( i ) + 3;
+		}
+		else {
+			n += FormatBound( row, i ) + 3;
+		}
+	}
+	return n;
+}
+
+static char * CSVOut( char * p, const Row & row, bool first ) {
+	for ( unsigned int i = 0; i < row.Size(); i++ ) {
+		if ( ! first || i > 0 ) {
+			*p++ = ',';
+		}
+		*p++ = '"';
+		if ( row.Type( i ) == CELL_TEXT ) {
+			p = CSVEscape( p, row.Data( i ), row.Length( i ) );
+		}
+		else {
+			p += FormatCell( row, i, p );
+		}
+		*p++ = '"';
+	}
+	return p;
+}
+
+unsigned int Row :: CSVSize() const {
+	unsigned int n = 1;
+	if ( Segmented() ) {
+		for ( unsigned int i = 0; i < mRep->mParts->mRows.size(); i++ ) {
+			n += CSVBound( mRep->mParts->mRows[i] );
+		}
+	}
+	else {
+		n += CSVBound( *this );
+	}
+	return n;
+}
+
+char * Row :: WriteCSV( char * p ) const {
+	if ( Segmented() ) {
+		char * start = p;
+		for ( unsigned int i = 0; i < mRep->mParts->mRows.size(); i++ ) {
+			p = CSVOut( p, mRep->mParts->mRows[i], p == start );
+		}
+		return p;
+	}
+	return CSVOut( p, *this, true );
+}
+
+//----------------------------------------------------------------------------
+// Binary form - field count, byte count, field end offsets, type bytes and
+// then the field data. The buffer need not be aligned, so the counts are
+// copied in and out with memcpy. Flat rows are written with a single copy
+// of each part of the block; segmented ones a field at a time.
+//----------------------------------------------------------------------------
+
+unsigned int Row :: BinarySize() const {
+	return 2 * sizeof( unsigned int )
+			+ Size() * (sizeof( unsigned int ) + 1) + ByteCount();
+}
+
+char * Row :: WriteBinary( char * p ) const {
+	unsigned int n = Size(), bytes = ByteCount();
+	std::memcpy( p, &n, sizeof( n ) );
+	p += sizeof( n );
+	std::memcpy( p, &bytes, sizeof( bytes ) );
+	p += sizeof( bytes );
+	if ( ! Segmented() ) {
+		RowBlock * b = Block();
+		std::memcpy( p, Offsets( b ) + 1, n * sizeof( unsigned int ) );
+		p += n * sizeof( unsigned int );
+		std::memcpy( p, Types( b ), n );
+		p += n;
+		std::memcpy( p, Bytes( b ), bytes );
+		return p + bytes;
+	}
+	char * types = p + n * sizeof( unsigned int );
+	char * data = types + n;
+	unsigned int end = 0;
+	for ( unsigned int i = 0; i < n; i++ ) {
+		unsigned int len = Length( i );
+		std::memcpy( data + end, Data( i ), len );
+		end += len;
+		std::memcpy( p, &end, sizeof( end ) );
+		p += sizeof( end );
+		types[i] = TypeByte( i );
+	}
+	return data + bytes;
+}
+
+const char * Row :: ReadBinary( const char * p ) {
+	unsigned int n, bytes;
+	std::memcpy( &n, p, sizeof( n ) );
+	p += sizeof( n );
+	std::memcpy( &bytes, p, sizeof( bytes ) );
+	p += sizeof( bytes );
+	*this = Row();
+	Reserve( n, bytes );
+	RowBlock * b = Block();
+	std::memcpy( Offsets( b ) + 1, p, n * sizeof( unsigned int ) );
+	p += n * sizeof( unsigned int );
+	std::memcpy( Types( b ), p, n );
+	p += n;
+	std::memcpy( Bytes( b ), p, bytes );
+	b->mFields = n;
+	b->mBytes = bytes;
+	return p + bytes;
+}
+
+//----------------------------------------------------------------------------
+// Return contents as CSV string
+//----------------------------------------------------------------------------
+
+string Row :: AsCSV() const {
+	vector <char> buf( CSVSize() );
+	return string( &buf[0], WriteCSV( &buf[0] ) );
 }
 
 //----------------------------------------------------------------------------
@@ -264,7 +936,7 @@ string Row :: AsCSV() const {
 
 std::ostream & operator << ( std::ostream & os, const Row & row ) {
 	for ( unsigned int i = 0; i < row.Size(); i++ ) {
-		os << "[" << row[i] << "]";
+		os << "[" << row.At( i ) << "]";
 	}
 	return os;
 }
@@ -285,38 +957,145 @@ bool operator != ( const Row & r1, const Row & r2 ) {
 	return ! (r1 == r2);
 }
 
+//----------------------------------------------------------------------------
+// Compare single fields. Fields are equal only when their formatted text is,
+// as that is what gets output, so Hash() can work on the text. Text is
+// compared in place, with same ordering as std::string. Ints, dates & times
+// with their own kind format uniquely, so are compared by value. Anything
+// else is formatted, and put in order by value if both fields are numbers.
+//----------------------------------------------------------------------------
+
+template <typename T> static int CmpValues( T a, T b ) {
+	return a < b ? -1 : (b < a ? 1 : 0);
+}
+
+static int CmpBytes( const char * p1, unsigned int l1,
+						const char * p2, unsigned int l2 ) {
+	int n = std::memcmp( p1, p2, std::min( l1, l2 ) );
+	if ( n ) {
+		return n < 0 ? -1 : 1;
+	}
+	return l1 < l2 ? -1 : (l1 > l2 ? 1 : 0);
+}
+
+static inline bool IsNumber( CellType t ) {
+	return t == CELL_INT || t == CELL_REAL;
+}
+
+static int CmpField( const Row & r1, const Row & r2, unsigned int i ) {
+	CellType t1 = r1.Type( i ), t2 = r2.Type( i );
+	if ( t1 == CELL_TEXT && t2 == CELL_TEXT ) {
+		return CmpBytes( r1.Data( i ), r1.Length( i ),
+							r2.Data( i ), r2.Length( i ) );
+	}
+	if ( t1 == t2 && t1 != CELL_REAL ) {
+		return CmpValues( IntValue( r1, i ), IntValue( r2, i ) );
+	}
+	char b1[ FORMAT_SIZE ], b2[ FORMAT_SIZE ];
+	const char * p1 = b1, * p2 = b2;
+	unsigned int l1, l2;
+	if ( t1 == CELL_TEXT ) {
+		p1 = r1.Data( i );
+		l1 = r1.Length( i );
+	}
+	else {
+		l1 = FormatCell( r1, i, b1 );
+	}
+	if ( t2 == CELL_TEXT ) {
+		p2 = r2.Data( i );
+		l2 = r2.Length( i );
+	}
+	else {
+		l2 = FormatCell( r2, i, b2 );
+	}
+	int n = CmpBytes( p1, l1, p2, l2 );
+	if ( n && IsNumber( t1 ) && IsNumber( t2 ) ) {
+		int v = CmpValues( RealValue( r1, i ), RealValue( r2, i ) );
+		return v ? v : n;
+	}
+	return n;
+}
+
 //----------------------------------------------------------------------------
 // Cmp returns as for strcmp. if the field list is non-empty only
 // consider the fields it contains.
 //----------------------------------------------------------------------------
 
 int Cmp( const Row & r1, const Row & r2, const FieldList & fl ) {
-	if ( r1.Size() <= r2.Size()  ) {
-		for ( unsigned int i = 0; i < r1.Size() ; i++ ) {
-			if ( fl.Size() == 0 || fl.Contains( i ) ) {
-				if ( r1.At( i ) < r2.At(i) ) {
-					return -1;
-				}
-				else if ( r1.At( i ) > r2.At(i) ) {
-					return 1;
-				}
+	unsigned int n = std::min( r1.Size(), r2.Size() );
+	for ( unsigned int i = 0; i < n ; i++ ) {
+		if ( fl.Size() == 0 || fl.Contains( i ) ) {
+			int c = CmpField( r1, r2, i );
+			if ( c ) {
+				return c;
 			}
 		}
-		return r1.Size() < r2.Size() ? -1 : 0;
+	}
+	if ( r1.Size() == r2.Size() ) {
+		return 0;
+	}
+	return r1.Size() < r2.Size() ? -1 : 1;
+}
+
+//----------------------------------------------------------------------------
+// Hashing is murmur3 style, a word at a time. Fields that compare equal have
+// the same formatted text, so it is the text that is hashed, with the
+// field's own bytes used for text fields.
+//----------------------------------------------------------------------------
+
+static inline unsigned long long HashMix( unsigned long long h,
+											unsigned long long k ) {
+	k *= 0x87c37b91114253d5ULL;
+	k = (k << 31) | (k >> 33);
+	k *= 0x4cf5ad432745937fULL;
+	h ^= k;
+	h = (h << 27) | (h >> 37);
+	return h * 5 + 0x52dce729;
+}
+
+static unsigned long long HashBytes( unsigned long long h,
+										const char * p, unsigned int len ) {
+	const char * end = p + len;
+	unsigned long long k;
+	while( end - p >= 8 ) {
+		std::memcpy( &k, p, 8 );
+		h = HashMix( h, k );
+		p += 8;
+	}
+	k = 0;
+	std::memcpy( &k, p, end - p );
+	return HashMix( h, k ^ ((unsigned long long) len << 56) );
+}
+
+static unsigned long long HashField( unsigned long long h,
+										const Row & r, unsigned int i ) {
+	if ( r.Type( i ) == CELL_TEXT ) {
+		return HashBytes( h, r.Data( i ), r.Length( i ) );
+	}
+	char buf[ FORMAT_SIZE ];
+	return HashBytes( h, buf, FormatCell( r, i, buf ) );
+}
+
+unsigned long long Hash( const Row & r, const FieldList & fl ) {
+	unsigned int n = r.Size();
+	unsigned long long h = n;
+	if ( fl.Size() == 0 ) {
+		for ( unsigned int i = 0; i < n; i++ ) {
+			h = HashField( h, r, i );
+		}
 	}
 	else {
-		for ( unsigned int i = 0; i < r2.Size() ; i++ ) {
-			if ( fl.Size() == 0 || fl.Contains( i ) ) {
-				if ( r1.At( i ) < r2.At(i) ) {
-					return -1;
-				}
-				else if ( r1.At( i ) > r2.At(i) ) {
-					return 1;
-				}
+		for ( unsigned int i = 0; i < fl.Size(); i++ ) {
+			if ( fl.At( i ) < n ) {
+				h = HashField( h, r, fl.At( i ) );
 			}
 		}
-		return 1;
 	}
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	return h ^ (h >> 33);
 }
 
 //----------------------------------------------------------------------------
@@ -381,6 +1160,115 @@ DEFTEST( Append ) {
 	FAILNE( r1[7], "eight" );
 	// self append - this is not a stupid to do
 	r1.AppendRow( r1 );
+	FAILNE( r1.Size(), 16 );
+	FAILNE( r1[15], "eight" );
+}
+
+// rows too big to be inline must move to the heap without losing values
+DEFTEST( Grow ) {
+	Row r1;
+	for ( unsigned int i = 0; i < 100; i++ ) {
+		r1.AppendValue( ALib::Str( i ) + "-some-padding" );
+	}
+	FAILNE( r1.Size(), 100 );
+	FAILNE( r1[0], "0-some-padding" );
+	FAILNE( r1[99], "99-some-padding" );
+	Row r2( "a,,c" );
+	r2.AppendRow( r1 );
+	FAILNE( r2.Size(), 103 );
+	FAILNE( r2[1], "" );
+	FAILNE( r2[102], "99-some-padding" );
+}
+
+// changing a copy must not change the original
+DEFTEST( CopyOnWrite ) {
+	Row r1;
+	for ( unsigned int i = 0; i < 50; i++ ) {
+		r1.AppendValue( "value" );
+	}
+	Row r2( r1 );
+	r2.AppendValue( "extra" );
+	r2.Erase( 0 );
+	FAILNE( r1.Size(), 50 );
+	FAILNE( r2.Size(), 50 );
+	FAILNE( r2[49], "extra" );
+	Row r3( "x,y" );
+	Row r4 = r3;
+	r4.Erase( 0 );
+	FAILNE( r3[0], "x" );
+	FAILNE( r4[0], "y" );
+	FAILNE( r4.Size(), 1 );
+}
+
+// appending by reference must look the same as appending by copy
+DEFTEST( AppendRef ) {
+	Row r1( "one,two" );
+	Row r2( "three" );
+	Row r;
+	r.AppendRef( r1 ).AppendRef( r2 );
+	FAILNE( r.Size(), 3 );
+	FAILNE( r[2], "three" );
+	Row r3;
+	r3.AppendRef( r ).AppendRef( r );
+	FAILNE( r3.Size(), 6 );
+	FAILNE( r3[4], "two" );
+	r3.AppendValue( "four" ).AppendRow( r1 );
+	FAILNE( r3.Size(), 9 );
+	FAILNE( r3[6], "four" );
+	FAILNE( r3[8], "two" );
+	FAILNE( r.Size(), 3 );
+	FAILNE( r1.Size(), 2 );
+	FAILNE( r3.AsCSV(), Row( r3.AsCSV() ).AsCSV() );
+	Row f( r3 );
+	f.Flatten();
+	FAILNE( Cmp( f, r3, FieldList() ), 0 );
+	f.Erase( 0 );
+	FAILNE( f[0], "two" );
+	FAILNE( r3[0], "one" );
+}
+
+// typed values format on access and compare by value
+DEFTEST( Typed ) {
+	Row r;
+	r.AppendInt( -42 ).AppendReal( 2.5, 2 ).AppendDate( 2009, 3, 7 );
+	r.AppendTime( 3661 ).AppendValue( "text" );
+	FAILNE( r.Size(), 5 );
+	FAILNE( r[0], "-42" );
+	FAILNE( r[1], "2.50" );
+	FAILNE( r[2], "2009-03-07" );
+	FAILNE( r[3], "01:01:01" );
+	FAILNE( r.Type( 4 ), CELL_TEXT );
+	FAILNE( r.AsCSV(), Row( "-42,2.50,2009-03-07,01:01:01,text" ).AsCSV() );
+	Row r1, r2;
+	r1.AppendInt( 9 );
+	r2.AppendInt( 10 );
+	FAILNE( Cmp( r1, r2, FieldList() ), -1 );
+	Row r3;
+	r3.AppendReal( 9.5, 1 );
+	FAILNE( Cmp( r3, r2, FieldList() ), -1 );
+	Row r4;
+	r4.AppendField( r, 2 ).AppendField( r, 4 );
+	FAILNE( r4.Type( 0 ), CELL_DATE );
+	r4.Erase( 0 );
+	FAILNE( r4[0], "text" );
+	FAILNE( r4.Type( 0 ), CELL_TEXT );
+}
+
+// hand formatting must match sprintf, including at the extremes
+DEFTEST( Format ) {
+	Row r;
+	r.AppendInt( 0 ).AppendInt( 7 ).AppendInt( 10 ).AppendInt( -100 );
+	r.AppendInt( 9223372036854775807LL ).AppendInt( -9223372036854775807LL - 1 );
+	r.AppendDate( 33, 1, 2 ).AppendTime( 0 ).AppendTime( 100 * 60 * 60 + 1 );
+	FAILNE( r[0], "0" );
+	FAILNE( r[1], "7" );
+	FAILNE( r[2], "10" );
+	FAILNE( r[3], "-100" );
+	FAILNE( r[4], "9223372036854775807" );
+	FAILNE( r[5], "-9223372036854775808" );
+	FAILNE( r[6], "0033-01-02" );
+	FAILNE( r[7], "00:00:00" );
+	FAILNE( r[8], "100:00:01" );
 }
 
 // test comparisons
@@ -395,6 +1283,79 @@ DEFTEST( Compare ) {
 	FAILNE( Cmp(r1, r4, FieldList("1,2") ), 0 );
 }
 
+// rows equal under Cmp must hash the same
+DEFTEST( Hash ) {
+	Row r1, r2, r3;
+	r1.AppendInt( 9 ).AppendReal( 2.5, 1 ).AppendValue( "a long text value" );
+	r2.AppendValue( "9" ).AppendReal( 2.54, 1 ).AppendValue( "a long text value" );
+	r3.AppendInt( 9 ).AppendReal( 2.5, 1 ).AppendValue( "a long text valuE" );
+	FAILNE( Cmp( r1, r2, FieldList() ), 0 );
+	FAILNE( Hash( r1, FieldList() ), Hash( r2, FieldList() ) );
+	FAILEQ( Hash( r1, FieldList() ), Hash( r3, FieldList() ) );
+	FAILNE( Hash( r1, FieldList( "1,2" ) ), Hash( r3, FieldList( "1,2" ) ) );
+	Row seg;
+	seg.AppendRef( Row( "x,y" ) ).AppendRef( r1 );
+	Row flat( seg );
+	flat.Flatten();
+	FAILNE( Hash( seg, FieldList() ), Hash( flat, FieldList() ) );
+	FAILEQ( Hash( Row( "x" ), FieldList() ), Hash( Row( "x," ), FieldList() ) );
+}
+
+// text and typed fields are equal when their text is, numbers are ordered
+// by value otherwise
+DEFTEST( CompareTyped ) {
+	Row r1, r2;
+	r1.AppendInt( 7 ).AppendDate( 2020, 1, 2 ).AppendReal( 2.5, 2 );
+	r2.AppendValue( "7" ).AppendValue( "2020-01-02" ).AppendValue( "2.50" );
+	FAILNE( Cmp( r1, r2, FieldList() ), 0 );
+	FAILNE( Hash( r1, FieldList() ), Hash( r2, FieldList() ) );
+	Row i9, r9, r10;
+	i9.AppendInt( 9 );
+	r9.AppendReal( 9, 2 );
+	r10.AppendReal( 10, 2 );
+	FAILEQ( Cmp( i9, r9, FieldList() ), 0 );
+	FAILNE( Cmp( i9, r10, FieldList() ), -1 );
+	FAILNE( Cmp( r10, i9, FieldList() ), 1 );
+}
+
+// binary form must round trip flat, segmented, long and empty rows
+DEFTEST( Binary ) {
+	Row flat;
+	flat.AppendInt( -7 ).AppendReal( 1.25, 2 ).AppendValue( "a \"b\"" );
+	Row seg;
+	seg.AppendRef( flat ).AppendRef( Row( "x,,y" ) );
+	Row big;
+	for ( unsigned int i = 0; i < 100; i++ ) {
+		big.AppendDate( 2000, 1, 1 + i % 28 ).AppendValue( "some text" );
+	}
+	Rows rows;
+	rows.push_back( flat );
+	rows.push_back( seg );
+	rows.push_back( big );
+	rows.push_back( Row() );
+	unsigned int size = 0;
+	for ( unsigned int i = 0; i < rows.size(); i++ ) {
+		size += rows[i].BinarySize();
+	}
+	vector <char> buf( size + 1 );
+	char * p = &buf[1];		// deliberately misaligned
+	for ( unsigned int i = 0; i < rows.size(); i++ ) {
+		p = rows[i].WriteBinary( p );
+	}
+	FAILNE( p - &buf[1], (int) size );
+	const char * q = &buf[1];
+	for ( unsigned int i = 0; i < rows.size(); i++ ) {
+		Row r( "old,contents" );
+		q = r.ReadBinary( q );
+		FAILNE( r.Size(), rows[i].Size() );
+		FAILNE( r.AsCSV(), rows[i].AsCSV() );
+		for ( unsigned int j = 0; j < r.Size(); j++ ) {
+			FAILNE( r.Type( j ), rows[i].Type( j ) );
+		}
+	}
+	FAILNE( q, (const char *) p );
+}
+
 #endif
 
 //----------------------------------------------------------------------------
@@ -0,0 +1,204 @@
+//---------------------------------------------------------------------------
+// dmk_rowhash.cpp
+//
+// Hashed set of rows. Hashes are kept in a flat table with linear probing,
+// so a lookup is usually a single cache miss.
+//
+// Copyright (C) 2009 Neil Butterworth
+//---------------------------------------------------------------------------
+
+#include "a_base.h"
+#include "dmk_rowhash.h"
+
+using std::string;
+using std::vector;
+
+namespace DMK {
+
+//----------------------------------------------------------------------------
+// Table starts at this size, and is doubled when more than 3/4 full
+//----------------------------------------------------------------------------
+
+const unsigned int HASH_SLOTS = 1024;
+
+//----------------------------------------------------------------------------
+
+RowHashSet :: RowHashSet( const FieldList & fields, bool verify )
+	: mFields( fields ), mVerify( verify ), mStore( &mRows ), mSize( 0 ) {
+}
+
+RowHashSet :: RowHashSet( const Rows & rows, const FieldList & fields )
+	: mFields( fields ), mVerify( true ), mStore( &rows ), mSize( 0 ) {
+}
+
+//----------------------------------------------------------------------------
+// Zero marks an empty slot, so is never used as a hash
+//----------------------------------------------------------------------------
+
+unsigned long long RowHashSet :: RowHash( const Row & row ) const {
+	unsigned long long h = Hash( row, mFields );
+	return h ? h : 1;
+}
+
+//----------------------------------------------------------------------------
+// Find the slot holding the row, or the empty slot where it would go
+//----------------------------------------------------------------------------
+
+unsigned int RowHashSet :: Find( const Row & row,
+									unsigned long long h ) const {
+	unsigned int mask = mSlots.size() - 1;
+	unsigned int i = h & mask;
+	while( mSlots[i] ) {
+		if ( mSlots[i] == h
+				&& ( ! mVerify || Cmp( (*mStore)[ mIndex[i] ], row, mFields ) == 0 ) ) {
+			break;
+		}
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+//----------------------------------------------------------------------------
+// Double table size. Entries are all different, so are placed by hash
+// alone without comparing rows.
+//----------------------------------------------------------------------------
+
+void RowHashSet :: Grow() {
+	unsigned int n = mSlots.empty() ? HASH_SLOTS : 2 * mSlots.size();
+	if ( n == 0 ) {
+		throw Exception( "Too many rows in hash table" );
+	}
+	vector <unsigned long long> slots( n, 0 );
+	vector <unsigned int> index( mVerify ? n : 0 );
+	unsigned int mask = n - 1;
+	for ( unsigned int i = 0; i < mSlots.size(); i++ ) {
+		if ( mSlots[i] ) {
+			unsigned int j = mSlots[i] & mask;
+			while( slots[j] ) {
+				j = (j + 1) & mask;
+			}
+			slots[j] = mSlots[i];
+			if ( mVerify ) {
+				index[j] = mIndex[i];
+			}
+		}
+	}
+	mSlots.swap( slots );
+	mIndex.swap( index );
+}
+
+//----------------------------------------------------------------------------
+// Add row, returning false if it (or one equal to it) is already there
+//----------------------------------------------------------------------------
+
+bool RowHashSet :: Insert( const Row & row ) {
+	if ( mSize >= mSlots.size() / 4 * 3 ) {
+		Grow();
+	}
+	unsigned long long h = RowHash( row );
+	unsigned int i = Find( row, h );
+	if ( mSlots[i] ) {
+		return false;
+	}
+	mSlots[i] = h;
+	if ( mVerify ) {
+		mIndex[i] = mStore->size();
+		if ( mStore == &mRows ) {
+			mRows.push_back( row );
+		}
+	}
+	mSize++;
+	return true;
+}
+
+bool RowHashSet :: Contains( const Row & row ) const {
+	if ( mSize == 0 ) {
+		return false;
+	}
+	return mSlots[ Find( row, RowHash( row ) ) ] != 0;
+}
+
+//----------------------------------------------------------------------------
+
+unsigned int RowHashSet :: Size() const {
+	return mSize;
+}
+
+void RowHashSet :: Clear() {
+	vector <unsigned long long>().swap( mSlots );
+	vector <unsigned int>().swap( mIndex );
+	Rows().swap( mRows );
+	mSize = 0;
+}
+
+//----------------------------------------------------------------------------
+
+} // namespace
+
+//----------------------------------------------------------------------------
+// Testing
+//----------------------------------------------------------------------------
+
+#ifdef DMK_TEST
+
+#include "a_myth.h"
+#include "a_str.h"
+using namespace ALib;
+using namespace DMK;
+
+DEFSUITE( "RowHash" );
+
+DEFTEST( Insert ) {
+	for ( int verify = 0; verify < 2; verify++ ) {
+		RowHashSet s( FieldList( "1" ), verify );
+		FAILNE( s.Contains( Row( "a,b" ) ), false );
+		FAILNE( s.Insert( Row( "a,b" ) ), true );
+		FAILNE( s.Insert( Row( "a,c" ) ), false );
+		FAILNE( s.Insert( Row( "b,c" ) ), true );
+		FAILNE( s.Contains( Row( "b,x" ) ), true );
+		FAILNE( s.Size(), 2 );
+		s.Clear();
+		FAILNE( s.Size(), 0 );
+		FAILNE( s.Insert( Row( "a,b" ) ), true );
+	}
+}
+
+DEFTEST( External ) {
+	Rows rows;
+	RowHashSet s( rows );
+	const char * vals[] = { "a,b", "a,c", "a,b", "b", "a,c" };
+	for ( unsigned int i = 0; i < 5; i++ ) {
+		Row r( vals[i] );
+		if ( s.Insert( r ) ) {
+			rows.push_back( r );
+		}
+	}
+	FAILNE( rows.size(), 3 );
+	FAILNE( rows[2].AsCSV(), Row( "b" ).AsCSV() );
+	FAILNE( s.Contains( Row( "a,c" ) ), true );
+}
+
+// enough rows to make the table grow several times
+DEFTEST( Grow ) {
+	RowHashSet s( FieldList(), true );
+	for ( int i = 0; i < 20000; i++ ) {
+		Row r;
+		r.AppendInt( i );
+		FAILNE( s.Insert( r ), true );
+	}
+	for ( int i = 0; i < 20000; i += 7 ) {
+		Row r;
+		r.AppendValue( "x" );
+		FAILNE( s.Contains( Row().AppendInt( i ) ), true );
+		FAILNE( s.Contains( r.AppendInt( i ) ), false );
+		FAILNE( s.Insert( Row().AppendValue( ALib::Str( i ) ) ), false );
+	}
+	FAILNE( s.Size(), 20000 );
+}
+
+#endif
+
+//----------------------------------------------------------------------------
+
+// end
+
@@ -28,6 +28,7 @@ const char * const GEN_FLAG 		= "-g";
 const char * const RANDVAL_FLAG 	= "-rn";
 const char * const TIME_SEED		= "time";
 const char * const COUNT_FLAG		= "-n";
+const char * const THREADS_FLAG	= "-j";
 
 
 //----------------------------------------------------------------------------
@@ -77,6 +78,7 @@ int DMKRun :: Run() {
 		FileManager fm( std::cout );	// create singleton
 		mCmdLine.AddFlag( ALib::CommandLineFlag( RANDVAL_FLAG, false, 1, true ) );
 		mCmdLine.AddFlag( ALib::CommandLineFlag( COUNT_FLAG, false, 1, true ) );
+		mCmdLine.AddFlag( ALib::CommandLineFlag( THREADS_FLAG, false, 1, true ) );
 		mCmdLine.CheckFlags(1);
 /*
 		mCmdLine.AddFlag( ALib::CommandLineFlag( GEN_FLAG, false, 1, true ) );
@@ -87,6 +89,7 @@ int DMKRun :: Run() {
 */
 		SeedRNG();
 		SetCmdLineCount();
+		SetCmdLineThreads();
 
 /*
 		int pos = 1;
@@ -112,6 +115,7 @@ int DMKRun :: Run() {
 		string filename = mCmdLine.File( 0 );
 		ModelManager::Instance()->AddModelFromFile( filename, ModelManager::mmGenForm );
 		ModelManager::Instance()->RunModels( std::cout );
+		fm.Flush();
 
 		return 0;
 	}
@@ -149,6 +153,29 @@ void DMKRun :: SetCmdLineCount() {
 	}
 }
 
+//----------------------------------------------------------------------------
+// Set default number of threads each generator uses from command line.
+//----------------------------------------------------------------------------
+
+void DMKRun :: SetCmdLineThreads() {
+	if ( mCmdLine.HasFlag( THREADS_FLAG ) ) {
+		string s = mCmdLine.GetValue( THREADS_FLAG, "" );
+		if ( ALib::IsInteger( s ) ) {
+			int n = ALib::ToInteger( s );
+			if ( n < 1 ) {
+				throw Exception( "Invalid value for threads: " + s );
+			}
+			ModelManager::Instance()->CommandLineThreads() = n;
+		}
+		else {
+			throw Exception( "Threads must be integer, not: " + s );
+		}
+	}
+	else {
+		ModelManager::Instance()->CommandLineThreads() = 1;
+	}
+}
+
 //----------------------------------------------------------------------------
 // Seed the random number generator. Default is to use current time as seed.
 //----------------------------------------------------------------------------
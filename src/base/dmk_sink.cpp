@@ -0,0 +1,519 @@
+//---------------------------------------------------------------------------
+// dmk_sink.cpp
+//
+// Output sinks. Rows are formatted directly into a large buffer which is
+// written out in one go, avoiding a temporary string and an iostream
+// insertion per row.
+//
+// Copyright (C) 2009 Neil Butterworth
+//---------------------------------------------------------------------------
+
+#include "a_base.h"
+#include "dmk_sink.h"
+#include <ostream>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+
+namespace DMK {
+
+//----------------------------------------------------------------------------
+// Base sink owns the buffer
+//----------------------------------------------------------------------------
+
+OutputSink :: OutputSink( unsigned int bufsize )
+	: mBuf( bufsize ), mPos( 0 ) {
+}
+
+OutputSink :: ~OutputSink() {
+}
+
+//----------------------------------------------------------------------------
+// Get n bytes of space in the buffer, writing out what is already there if
+// need be. The buffer grows if a single item will not fit in it.
+//----------------------------------------------------------------------------
+
+char * OutputSink :: Space( unsigned int n ) {
+	if ( mPos + n > mBuf.size() ) {
+		Flush();
+		if ( n > mBuf.size() ) {
+			mBuf.resize( n );
+		}
+	}
+	return &mBuf[ mPos ];
+}
+
+//----------------------------------------------------------------------------
+// Write row as a line of CSV
+//----------------------------------------------------------------------------
+
+void OutputSink :: Write( const Row & row ) {
+	char * start = Space( row.CSVSize() + 1 );
+	char * p = row.WriteCSV( start );
+	*p++ = '\n';
+	mPos += p - start;
+}
+
+//----------------------------------------------------------------------------
+// Write literal text
+//----------------------------------------------------------------------------
+
+void OutputSink :: Write( const string & text ) {
+	Write( text.data(), text.size() );
+}
+
+//----------------------------------------------------------------------------
+// Write a block of text, bypassing the buffer if the block won't fit in it
+//----------------------------------------------------------------------------
+
+void OutputSink :: Write( const char * data, unsigned int n ) {
+	if ( n >= mBuf.size() ) {
+		Flush();
+		WriteOut( data, n );
+	}
+	else if ( n ) {
+		std::memcpy( Space( n ), data, n );
+		mPos += n;
+	}
+}
+
+//----------------------------------------------------------------------------
+// Pass anything buffered on to the real output
+//----------------------------------------------------------------------------
+
+void OutputSink :: Flush() {
+	if ( mPos ) {
+		unsigned int n = mPos;
+		mPos = 0;
+		WriteOut( &mBuf[0], n );
+	}
+}
+
+//----------------------------------------------------------------------------
+// File sinks either open the named file or use an existing descriptor
+//----------------------------------------------------------------------------
+
+FileSink :: FileSink( const string & fname )
+	: mFd( -1 ), mOwnFd( true ), mName( fname ) {
+	mFd = ::open( fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+	if ( mFd < 0 ) {
+		throw Exception( "Cannot open output file " + fname );
+	}
+}
+
+FileSink :: FileSink( int fd, const string & name )
+	: mFd( fd ), mOwnFd( false ), mName( name ) {
+}
+
+//----------------------------------------------------------------------------
+// Errors can't be reported from here - users who care should call Flush()
+// before destroying the sink.
+//----------------------------------------------------------------------------
+
+FileSink :: ~FileSink() {
+	try {
+		Flush();
+	}
+	catch( ... ) {
+	}
+	if ( mOwnFd ) {
+		::close( mFd );
+	}
+}
+
+//----------------------------------------------------------------------------
+// Writes may be partial or interrupted, so loop until all is written
+//----------------------------------------------------------------------------
+
+void FileSink :: WriteOut( const char * data, unsigned int n ) {
+	while( n ) {
+		int w = ::write( mFd, data, n );
+		if ( w < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			throw Exception( "Write failed on " + mName + ": "
+								+ std::strerror( errno ) );
+		}
+		data += w;
+		n -= w;
+	}
+}
+
+//----------------------------------------------------------------------------
+// Stream sink
+//----------------------------------------------------------------------------
+
+StreamSink :: StreamSink( std::ostream & os ) : mOut( os ) {
+}
+
+StreamSink :: ~StreamSink() {
+	try {
+		Flush();
+	}
+	catch( ... ) {
+	}
+}
+
+void StreamSink :: WriteOut( const char * data, unsigned int n ) {
+	mOut.write( data, n );
+	if ( ! mOut ) {
+		throw Exception( "Write to output stream failed" );
+	}
+}
+
+//----------------------------------------------------------------------------
+// Null sink only needs a small buffer as it is emptied without being used
+//----------------------------------------------------------------------------
+
+NullSink :: NullSink() : OutputSink( 4096 ) {
+}
+
+void NullSink :: WriteOut( const char *, unsigned int ) {
+}
+
+//----------------------------------------------------------------------------
+// A batch of rows to be formatted, or made and formatted if the job has a
+// maker. Jobs are FREE when their text (if any) has been written, QUEUED
+// from being given to the workers until they have been formatted, and DONE
+// when formatted but not yet written.
+//----------------------------------------------------------------------------
+
+struct ParallelWriter::Job {
+
+	enum State { FREE, QUEUED, DONE };
+
+	Job() : mCount( 0 ), mMaker( 0 ), mFirst( 0 ), mSize( 0 ),
+				mState( FREE ) {}
+
+	Rows mRows;
+	unsigned int mCount;
+	const RowMaker * mMaker;
+	unsigned long long mFirst;			// index of first row to make
+	vector <char> mText;
+	unsigned int mSize;
+	State mState;
+	string mError;
+};
+
+//----------------------------------------------------------------------------
+// Start the worker threads. There are two jobs per worker so the caller can
+// be generating one batch while another waits to be formatted.
+//----------------------------------------------------------------------------
+
+ParallelWriter :: ParallelWriter( OutputSink & out, unsigned int nthreads )
+	: mOut( out ), mNext( 0 ), mStop( false ) {
+	if ( nthreads == 0 ) {
+		throw Exception( "Need at least one thread to write output" );
+	}
+	pthread_mutex_init( &mLock, 0 );
+	pthread_cond_init( &mWork, 0 );
+	pthread_cond_init( &mDone, 0 );
+	for ( unsigned int i = 0; i < 2 * nthreads; i++ ) {
+		mJobs.push_back( new Job );
+	}
+	for ( unsigned int i = 0; i < nthreads; i++ ) {
+		pthread_t t;
+		if ( pthread_create( &t, 0, Work, this ) != 0 ) {
+			Stop();
+			throw Exception( "Cannot create output thread" );
+		}
+		mThreads.push_back( t );
+	}
+}
+
+//----------------------------------------------------------------------------
+// Anything not already written by Finish() is discarded, which is what is
+// wanted if we are here because of an exception.
+//----------------------------------------------------------------------------
+
+ParallelWriter :: ~ParallelWriter() {
+	Stop();
+}
+
+//----------------------------------------------------------------------------
+// Stop the workers and free everything
+//----------------------------------------------------------------------------
+
+void ParallelWriter :: Stop() {
+	pthread_mutex_lock( &mLock );
+	mStop = true;
+	pthread_cond_broadcast( &mWork );
+	pthread_mutex_unlock( &mLock );
+	for ( unsigned int i = 0; i < mThreads.size(); i++ ) {
+		pthread_join( mThreads[i], 0 );
+	}
+	mThreads.clear();
+	for ( unsigned int i = 0; i < mJobs.size(); i++ ) {
+		delete mJobs[i];
+	}
+	mJobs.clear();
+	pthread_cond_destroy( &mDone );
+	pthread_cond_destroy( &mWork );
+	pthread_mutex_destroy( &mLock );
+}
+
+//----------------------------------------------------------------------------
+// Queue the first n rows of batch for formatting. The oldest job is reused,
+// so its text is written first - this is what keeps the output in order.
+// The rows are swapped into the job, so no row is copied or destroyed
+// while a worker might be reading it.
+//----------------------------------------------------------------------------
+
+void ParallelWriter :: Write( Rows & batch, unsigned int n ) {
+	if ( n == 0 ) {
+		return;
+	}
+	Job * job = mJobs[ mNext ];
+	mNext = (mNext + 1) % mJobs.size();
+	Collect( job );
+	job->mRows.swap( batch );
+	job->mCount = n;
+	job->mMaker = 0;
+	Queue( job );
+}
+
+//----------------------------------------------------------------------------
+// Queue rows first to first + n - 1 to be made by the maker and formatted.
+// The rows are made in the job's own row vector, which only the worker
+// touches until the job is done.
+//----------------------------------------------------------------------------
+
+void ParallelWriter :: Write( const RowMaker & maker, unsigned long long first,
+								unsigned int n ) {
+	if ( n == 0 ) {
+		return;
+	}
+	Job * job = mJobs[ mNext ];
+	mNext = (mNext + 1) % mJobs.size();
+	Collect( job );
+	job->mCount = n;
+	job->mMaker = &maker;
+	job->mFirst = first;
+	Queue( job );
+}
+
+//----------------------------------------------------------------------------
+// Hand job to the workers
+//----------------------------------------------------------------------------
+
+void ParallelWriter :: Queue( Job * job ) {
+	pthread_mutex_lock( &mLock );
+	job->mState = Job::QUEUED;
+	mQueue.push_back( job );
+	pthread_cond_signal( &mWork );
+	pthread_mutex_unlock( &mLock );
+}
+
+//----------------------------------------------------------------------------
+// Write all outstanding jobs, oldest first
+//----------------------------------------------------------------------------
+
+void ParallelWriter :: Finish() {
+	for ( unsigned int i = 0; i < mJobs.size(); i++ ) {
+		Collect( mJobs[ (mNext + i) % mJobs.size() ] );
+	}
+}
+
+//----------------------------------------------------------------------------
+// Wait for a job to be formatted and write its text to the sink
+//----------------------------------------------------------------------------
+
+void ParallelWriter :: Collect( Job * job ) {
+	pthread_mutex_lock( &mLock );
+	while( job->mState == Job::QUEUED ) {
+		pthread_cond_wait( &mDone, &mLock );
+	}
+	pthread_mutex_unlock( &mLock );
+	if ( job->mState == Job::DONE ) {
+		job->mState = Job::FREE;
+		if ( job->mError != "" ) {
+			throw Exception( job->mError );
+		}
+		mOut.Write( &job->mText[0], job->mSize );
+	}
+}
+
+//----------------------------------------------------------------------------
+// Worker thread - format jobs until told to stop
+//----------------------------------------------------------------------------
+
+void * ParallelWriter :: Work( void * p ) {
+	ParallelWriter * pw = static_cast <ParallelWriter *>( p );
+	pthread_mutex_lock( &pw->mLock );
+	while( true ) {
+		while( pw->mQueue.empty() && ! pw->mStop ) {
+			pthread_cond_wait( &pw->mWork, &pw->mLock );
+		}
+		if ( pw->mStop ) {
+			break;
+		}
+		Job * job = pw->mQueue.front();
+		pw->mQueue.pop_front();
+		pthread_mutex_unlock( &pw->mLock );
+		Format( job );
+		pthread_mutex_lock( &pw->mLock );
+		job->mState = Job::DONE;
+		pthread_cond_broadcast( &pw->mDone );
+	}
+	pthread_mutex_unlock( &pw->mLock );
+	return 0;
+}
+
+//----------------------------------------------------------------------------
+// Make a job's rows if need be, and format them as lines of CSV. Exceptions
+// can't cross threads, so are passed back to the writer's thread as an
+// error message.
+//----------------------------------------------------------------------------
+
+void ParallelWriter :: Format( Job * job ) {
+	try {
+		job->mError = "";
+		if ( job->mMaker ) {
+			job->mRows.assign( job->mCount, Row() );
+			for ( unsigned int i = 0; i < job->mCount; i++ ) {
+				job->mMaker->MakeRow( job->mRows[i], job->mFirst + i );
+			}
+		}
+		unsigned int size = 0;
+		for ( unsigned int i = 0; i < job->mCount; i++ ) {
+			size += job->mRows[i].CSVSize() + 1;
+		}
+		if ( job->mText.size() < size ) {
+			job->mText.resize( size );
+		}
+		char * start = &job->mText[0];
+		char * p = start;
+		for ( unsigned int i = 0; i < job->mCount; i++ ) {
+			p = job->mRows[i].WriteCSV( p );
+			*p++ = '\n';
+		}
+		job->mSize = p - start;
+	}
+	catch( const std::exception & ex ) {
+		job->mError = ex.what();
+	}
+	catch( ... ) {
+		job->mError = "Unknown exception formatting output";
+	}
+}
+
+//----------------------------------------------------------------------------
+
+} // namespace
+
+//----------------------------------------------------------------------------
+// Testing
+//----------------------------------------------------------------------------
+
+#ifdef DMK_TEST
+
+#include "a_myth.h"
+#include <sstream>
+using namespace ALib;
+using namespace DMK;
+
+DEFSUITE( "Sink" );
+
+DEFTEST( StreamOut ) {
+	std::ostringstream os;
+	StreamSink s( os );
+	Row r;
+	r.AppendValue( "say \"hi\"" ).AppendInt( 42 );
+	s.Write( r );
+	s.Write( "text\n" );
+	FAILNE( os.str(), "" );
+	s.Flush();
+	FAILNE( os.str(), "\"say \"\"hi\"\"\",\"42\"\ntext\n" );
+}
+
+DEFTEST( Overflow ) {
+	std::ostringstream os;
+	string line;
+	{
+		StreamSink s( os );
+		Row r;
+		for ( unsigned int i = 0; i < 100; i++ ) {
+			r.AppendReal( i / 4.0, 2 );
+		}
+		line = r.AsCSV() + "\n";
+		for ( unsigned int i = 0; i < 1000; i++ ) {
+			s.Write( r );
+		}
+	}
+	FAILNE( os.str().size(), 1000 * line.size() );
+	FAILNE( os.str().substr( 999 * line.size() ), line );
+}
+
+// output must be in the order batches were written, whatever the threads do
+DEFTEST( Parallel ) {
+	std::ostringstream os1, os2;
+	StreamSink s1( os1 ), s2( os2 );
+	ParallelWriter pw( s2, 3 );
+	Rows batch;
+	for ( unsigned int i = 0; i < 50; i++ ) {
+		unsigned int n = 1 + (i * 37) % 100;
+		batch.assign( n, Row() );
+		for ( unsigned int j = 0; j < n; j++ ) {
+			batch[j].AppendInt( i ).AppendInt( j ).AppendValue( "a\"b" );
+			s1.Write( batch[j] );
+		}
+		pw.Write( batch, n );
+	}
+	pw.Finish();
+	s1.Flush();
+	s2.Flush();
+	FAILEQ( os1.str(), "" );
+	FAILNE( os2.str(), os1.str() );
+}
+
+struct SquareMaker : public RowMaker {
+	void MakeRow( Row & row, unsigned long long i ) const {
+		row.AppendInt( i ).AppendInt( i * i );
+	}
+};
+
+// rows made on the workers come out in order, mixed with batches
+DEFTEST( ParallelMake ) {
+	std::ostringstream os1, os2;
+	StreamSink s1( os1 ), s2( os2 );
+	ParallelWriter pw( s2, 3 );
+	SquareMaker sm;
+	Rows batch;
+	unsigned long long first = 0;
+	for ( unsigned int i = 0; i < 50; i++ ) {
+		unsigned int n = 1 + (i * 37) % 100;
+		if ( i % 3 ) {
+			for ( unsigned int j = 0; j < n; j++ ) {
+				Row r;
+				sm.MakeRow( r, first + j );
+				s1.Write( r );
+			}
+			pw.Write( sm, first, n );
+			first += n;
+		}
+		else {
+			batch.assign( n, Row() );
+			for ( unsigned int j = 0; j < n; j++ ) {
+				batch[j].AppendValue( "batch" ).AppendInt( j );
+				s1.Write( batch[j] );
+			}
+			pw.Write( batch, n );
+		}
+	}
+	pw.Finish();
+	s1.Flush();
+	s2.Flush();
+	FAILNE( os2.str(), os1.str() );
+}
+
+#endif
+
+//----------------------------------------------------------------------------
+
+// end
+
@@ -0,0 +1,367 @@
+//---------------------------------------------------------------------------
+// dmk_sort.cpp
+//
+// External merge sort of rows. Rows are sorted in memory until they exceed
+// a budget, then written out as sorted runs in the binary row format and
+// merged back together with a heap.
+//
+// Copyright (C) 2009 Neil Butterworth
+//---------------------------------------------------------------------------
+
+#include "a_base.h"
+#include "dmk_sort.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+using std::string;
+using std::vector;
+
+namespace DMK {
+
+//----------------------------------------------------------------------------
+// Most runs merged at once. When there are more than this, some of the
+// existing runs are merged into one so we don't run out of file handles.
+//----------------------------------------------------------------------------
+
+const unsigned int MAX_RUNS = 64;
+
+//----------------------------------------------------------------------------
+// A run is a temporary file of rows, each preceded by the size of its
+// binary form, plus the row at the head of the run during a merge.
+//----------------------------------------------------------------------------
+
+struct RowSorter::Run {
+
+	Run() : mFile( std::tmpfile() ) {
+		if ( mFile == 0 ) {
+			throw Exception( "Cannot create temporary file for sort" );
+		}
+	}
+
+	~Run() {
+		std::fclose( mFile );
+	}
+
+	void Write( const Row & row, vector <char> & buf ) {
+		unsigned int n = row.BinarySize();
+		buf.resize( n + sizeof( n ) );
+		std::memcpy( &buf[0], &n, sizeof( n ) );
+		row.WriteBinary( &buf[0] + sizeof( n ) );
+		if ( std::fwrite( &buf[0], 1, buf.size(), mFile ) != buf.size() ) {
+			throw Exception( "Write to temporary file for sort failed" );
+		}
+	}
+
+	void Rewind() {
+		if ( std::fflush( mFile ) != 0 ) {
+			throw Exception( "Write to temporary file for sort failed" );
+		}
+		std::rewind( mFile );
+	}
+
+	bool Read( vector <char> & buf ) {
+		unsigned int n;
+		if ( std::fread( &n, sizeof( n ), 1, mFile ) != 1 ) {
+			return false;
+		}
+		buf.resize( n );
+		if ( std::fread( &buf[0], 1, n, mFile ) != n ) {
+			throw Exception( "Read from temporary file for sort failed" );
+		}
+		mRow.ReadBinary( &buf[0] );
+		return true;
+	}
+
+	std::FILE * mFile;
+	Row mRow;
+};
+
+//----------------------------------------------------------------------------
+// Heap order for the merge - the greatest run comes first, so this puts
+// the run with the smallest head row at the top. Equal rows are taken from
+// the earlier run, which keeps the sort stable.
+//----------------------------------------------------------------------------
+
+struct RowSorter::RunOrder {
+
+	RunOrder( const vector <Run *> & runs, const FieldList & fl )
+		: mRuns( runs ), mFields( fl ) {}
+
+	bool operator()( unsigned int a, unsigned int b ) const {
+		int c = Cmp( mRuns[a]->mRow, mRuns[b]->mRow, mFields );
+		return c > 0 || (c == 0 && a > b);
+	}
+
+	const vector <Run *> & mRuns;
+	const FieldList & mFields;
+};
+
+//----------------------------------------------------------------------------
+// Used to sort the rows held in memory
+//----------------------------------------------------------------------------
+
+struct RowLess {
+
+	RowLess( const FieldList & fl ) : mFields( fl ) {}
+
+	bool operator()( const Row & lhs, const Row & rhs ) const {
+		return Cmp( lhs, rhs, mFields ) < 0;
+	}
+
+	const FieldList & mFields;
+};
+
+//----------------------------------------------------------------------------
+// Create with fields to sort on and memory budget in bytes
+//----------------------------------------------------------------------------
+
+RowSorter :: RowSorter( const FieldList & fields, unsigned int budget )
+	: mFields( fields ), mBudget( budget ), mUsed( 0 ), mPos( 0 ) {
+}
+
+RowSorter :: ~RowSorter() {
+	for ( unsigned int i = 0; i < mRuns.size(); i++ ) {
+		delete mRuns[i];
+	}
+}
+
+//----------------------------------------------------------------------------
+// Add row, spilling what we have if that takes us over budget. The size
+// of the binary form is a fair estimate of the heap space a row uses.
+//----------------------------------------------------------------------------
+
+void RowSorter :: Add( const Row & row ) {
+	mRows.push_back( row );
+	mUsed += sizeof( Row ) + row.BinarySize();
+	if ( mUsed > mBudget ) {
+		Spill();
+	}
+}
+
+//----------------------------------------------------------------------------
+// Sort rows in memory and write them out as a new run
+//----------------------------------------------------------------------------
+
+void RowSorter :: Spill() {
+	if ( mRuns.size() == MAX_RUNS ) {
+		MergeRuns();
+	}
+	std::stable_sort( mRows.begin(), mRows.end(), RowLess( mFields ) );
+	std::auto_ptr <Run> run( new Run );
+	for ( unsigned int i = 0; i < mRows.size(); i++ ) {
+		run->Write( mRows[i], mBuf );
+	}
+	mRuns.push_back( run.release() );
+	mLevels.push_back( 0 );
+	Rows().swap( mRows );
+	mUsed = 0;
+}
+
+//----------------------------------------------------------------------------
+// Replace the newest runs with a single run containing their merged rows.
+// Runs are merged level by level, as in a binary counter, so a row is
+// merged again only once for each level rather than each time the runs
+// fill up. The levels never go up from oldest to newest run, so the runs
+// merged are those at the level of the next to last run, with the last
+// run thrown in. They are always next to each other, which keeps the
+// sort stable.
+//----------------------------------------------------------------------------
+
+void RowSorter :: MergeRuns() {
+	unsigned int level = mLevels[ mRuns.size() - 2 ];
+	unsigned int first = mRuns.size() - 2;
+	while( first > 0 && mLevels[ first - 1 ] == level ) {
+		first--;
+	}
+	std::auto_ptr <Run> merged( new Run );
+	StartMerge( first );
+	Row row;
+	while( NextMerged( row ) ) {
+		merged->Write( row, mBuf );
+	}
+	for ( unsigned int i = first; i < mRuns.size(); i++ ) {
+		delete mRuns[i];
+	}
+	mRuns.resize( first );
+	mLevels.resize( first );
+	mRuns.push_back( merged.release() );
+	mLevels.push_back( level + 1 );
+}
+
+//----------------------------------------------------------------------------
+// Read the first row of each run from first on and build the merge heap
+//----------------------------------------------------------------------------
+
+void RowSorter :: StartMerge( unsigned int first ) {
+	mHeap.clear();
+	for ( unsigned int i = first; i < mRuns.size(); i++ ) {
+		mRuns[i]->Rewind();
+		if ( mRuns[i]->Read( mBuf ) ) {
+			mHeap.push_back( i );
+		}
+	}
+	std::make_heap( mHeap.begin(), mHeap.end(), RunOrder( mRuns, mFields ) );
+}
+
+//----------------------------------------------------------------------------
+// Take the smallest head row and refill its run's place in the heap
+//----------------------------------------------------------------------------
+
+bool RowSorter :: NextMerged( Row & row ) {
+	if ( mHeap.empty() ) {
+		return false;
+	}
+	RunOrder order( mRuns, mFields );
+	std::pop_heap( mHeap.begin(), mHeap.end(), order );
+	Run * run = mRuns[ mHeap.back() ];
+	row = run->mRow;
+	if ( run->Read( mBuf ) ) {
+		std::push_heap( mHeap.begin(), mHeap.end(), order );
+	}
+	else {
+		mHeap.pop_back();
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// Call once all rows are added. If nothing has been spilled the sort is
+// done entirely in memory, otherwise the last rows become a run too.
+//----------------------------------------------------------------------------
+
+void RowSorter :: Sort() {
+	if ( mRuns.empty() ) {
+		std::stable_sort( mRows.begin(), mRows.end(), RowLess( mFields ) );
+		mPos = 0;
+	}
+	else {
+		if ( mRows.size() ) {
+			Spill();
+		}
+		StartMerge( 0 );
+	}
+}
+
+//----------------------------------------------------------------------------
+// Get next row in sorted order, returning false when there are no more
+//----------------------------------------------------------------------------
+
+bool RowSorter :: Next( Row & row ) {
+	if ( ! mRuns.empty() ) {
+		return NextMerged( row );
+	}
+	if ( mPos == mRows.size() ) {
+		return false;
+	}
+	row = mRows[ mPos++ ];
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// How many runs have been written - zero if the sort was in memory
+//----------------------------------------------------------------------------
+
+unsigned int RowSorter :: Runs() const {
+	return mRuns.size();
+}
+
+//----------------------------------------------------------------------------
+
+} // namespace
+
+//----------------------------------------------------------------------------
+// Testing
+//----------------------------------------------------------------------------
+
+#ifdef DMK_TEST
+
+#include "a_myth.h"
+#include "dmk_random.h"
+using namespace ALib;
+using namespace DMK;
+
+DEFSUITE( "Sort" );
+
+// build rows with few distinct keys, so stability is tested, and a serial
+// number to check the order of equal rows by
+static Rows SortRows( unsigned int n ) {
+	RandomStream rs( 42 );
+	Rows rows;
+	for ( unsigned int i = 0; i < n; i++ ) {
+		Row r;
+		r.AppendInt( rs.Below( 10 ) ).AppendValue( string( rs.Below( 30 ), 'x' ) );
+		r.AppendInt( i );
+		rows.push_back( r );
+	}
+	return rows;
+}
+
+static Rows Sorted( RowSorter & s, const Rows & rows ) {
+	for ( unsigned int i = 0; i < rows.size(); i++ ) {
+		s.Add( rows[i] );
+	}
+	s.Sort();
+	Rows out;
+	Row r;
+	while( s.Next( r ) ) {
+		out.push_back( r );
+	}
+	return out;
+}
+
+DEFTEST( InMemory ) {
+	Rows rows = SortRows( 1000 );
+	RowSorter s( FieldList( "1" ), 1000000 );
+	Rows out = Sorted( s, rows );
+	FAILNE( s.Runs(), 0 );
+	std::stable_sort( rows.begin(), rows.end(), RowLess( FieldList( "1" ) ) );
+	FAILNE( out.size(), rows.size() );
+	for ( unsigned int i = 0; i < rows.size(); i++ ) {
+		FAILNE( out[i].AsCSV(), rows[i].AsCSV() );
+	}
+}
+
+// a small budget gives many runs, and more than can be merged at once
+DEFTEST( Spilled ) {
+	Rows rows = SortRows( 20000 );
+	FieldList fl( "1,2" );
+	RowSorter s( fl, 20000 );
+	Rows out = Sorted( s, rows );
+	FAILNE( s.Runs() > 1, true );
+	std::stable_sort( rows.begin(), rows.end(), RowLess( fl ) );
+	FAILNE( out.size(), rows.size() );
+	for ( unsigned int i = 0; i < rows.size(); i++ ) {
+		FAILNE( out[i].AsCSV(), rows[i].AsCSV() );
+		FAILNE( out[i].Type( 0 ), CELL_INT );
+	}
+}
+
+// so many runs that merged runs are themselves merged
+DEFTEST( Levels ) {
+	Rows rows = SortRows( 20000 );
+	FieldList fl( "1" );
+	RowSorter s( fl, 200 );
+	Rows out = Sorted( s, rows );
+	FAILNE( s.Runs() > 1 && s.Runs() <= MAX_RUNS, true );
+	std::stable_sort( rows.begin(), rows.end(), RowLess( fl ) );
+	FAILNE( out.size(), rows.size() );
+	for ( unsigned int i = 0; i < rows.size(); i++ ) {
+		FAILNE( out[i].AsCSV(), rows[i].AsCSV() );
+	}
+}
+
+DEFTEST( Empty ) {
+	RowSorter s( FieldList( "1" ), 0 );
+	s.Sort();
+	Row r;
+	FAILNE( s.Next( r ), false );
+}
+
+#endif
+
+//----------------------------------------------------------------------------
+
+// end
+
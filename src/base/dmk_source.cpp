@@ -12,6 +12,7 @@
 #include "dmk_source.h"
 #include "dmk_tagdict.h"
 #include "dmk_random.h"
+#include <map>
 
 using std::string;
 using std::vector;
@@ -20,25 +21,140 @@ namespace DMK {
 
 //----------------------------------------------------------------------------
 
+// each source gets the stream for its place in the model
 DataSource :: DataSource( const FieldList & order )
-	: mOrder( order ) {
+	: mOrder( order ), mRand( RNG::StreamKey( SourceScope::NextPath() ) ) {
 }
 
 // default discard action is to do nothing
 void DataSource :: Discard() {
 }
 
-Row DataSource :: Last() const {
-	return mLast;
+bool DataSource :: Ordered() const {
+	return mOrder.Size() != 0;
 }
 
-Row DataSource :: SaveLast( const Row & row ) const {
-	return mLast = row;
+Row DataSource :: Order( const Row & row ) const {
+	return mOrder.OrderRow( row );
 }
 
-Row DataSource :: Order( const Row & row ) const {
-	Row r = mOrder.OrderRow( row );
-	return SaveLast( r );
+// random values for this source only
+RandomStream & DataSource :: Rand() const {
+	return mRand;
+}
+
+// default emit action appends the row from Get() - the row is referred
+// to rather than copied
+void DataSource :: Emit( Row & row ) {
+	row.AppendRef( Get() );
+}
+
+// append the next n rows to the n rows supplied, one to each
+void DataSource :: EmitBatch( Rows & rows, unsigned int n ) {
+	for ( unsigned int i = 0; i < n; i++ ) {
+		Emit( rows[i] );
+	}
+}
+
+// get n new rows in one go
+void DataSource :: GetBatch( Rows & rows, unsigned int n ) {
+	rows.assign( n, Row() );
+	EmitBatch( rows, n );
+}
+
+//----------------------------------------------------------------------------
+// A frame for each scope that is open. Children are named by their tag and
+// attributes, numbered only among identical siblings, so adding or editing
+// one source doesn't rename the others. Sources a tag makes for itself
+// (rather than from child elements) are numbered within the tag's frame.
+//----------------------------------------------------------------------------
+
+struct SourceScope::Frame {
+
+	Frame( const string & path ) : mPath( path ), mMade( 0 ) {}
+
+	string mPath;
+	std::map <string, unsigned int> mSeen;
+	unsigned int mMade;
+};
+
+// bottom frame is for sources made outside any scope
+vector <SourceScope::Frame> & SourceScope :: Frames() {
+	static vector <Frame> frames( 1, Frame( "" ) );
+	return frames;
+}
+
+SourceScope :: SourceScope( const string & name ) {
+	Frame & parent = Frames().back();
+	unsigned int n = parent.mSeen[ name ]++;
+	string path = parent.mPath + "/" + name + "[" + ALib::Str( n ) + "]";
+	Frames().push_back( Frame( path ) );
+}
+
+SourceScope :: ~SourceScope() {
+	Frames().pop_back();
+}
+
+// element name is tag plus attributes, in the order they were written
+string SourceScope :: ElementName( const ALib::XMLElement * e ) {
+	string name = e->Name() + "(";
+	for ( unsigned int i = 0; i < e->AttrCount(); i++ ) {
+		string attr = e->AttrName( i );
+		name += (i ? "," : "") + attr + "=" + e->AttrValue( attr );
+	}
+	return name + ")";
+}
+
+// path for the next source made in the current scope
+string SourceScope :: NextPath() {
+	Frame & f = Frames().back();
+	unsigned int n = f.mMade++;
+	if ( Frames().size() == 1 ) {
+		return "#" + ALib::Str( n );
+	}
+	return n == 0 ? f.mPath : f.mPath + "#" + ALib::Str( n );
+}
+
+//----------------------------------------------------------------------------
+
+LeafSource :: LeafSource( const FieldList & order )
+	: DataSource( order ) {
+}
+
+Row LeafSource :: Get() {
+	Row r;
+	EmitCells( r );
+	return Order( r );
+}
+
+// without an order the cells can go straight into the caller's row,
+// otherwise they have to be re-ordered on the way
+void LeafSource :: Emit( Row & row ) {
+	if ( Ordered() ) {
+		row.AppendRow( Get() );
+	}
+	else {
+		EmitCells( row );
+	}
+}
+
+void LeafSource :: EmitBatch( Rows & rows, unsigned int n ) {
+	if ( Ordered() ) {
+		for ( unsigned int i = 0; i < n; i++ ) {
+			rows[i].AppendRow( Get() );
+		}
+	}
+	else {
+		EmitCellBatch( rows, n );
+	}
+}
+
+// default bulk action emits cells a row at a time - sources that can
+// produce values more cheaply in bulk should override this
+void LeafSource :: EmitCellBatch( Rows & rows, unsigned int n ) {
+	for ( unsigned int i = 0; i < n; i++ ) {
+		EmitCells( rows[i] );
+	}
 }
 
 //----------------------------------------------------------------------------
@@ -64,12 +180,35 @@ DataSource * CompositeDataSource :: SourceAt( unsigned int i ) const {
 	return mSources.at( i );
 }
 
+// each child adds its values directly to the row
 Row CompositeDataSource :: Get() {
 	Row r;
+	EmitChildren( r );
+	return Order( r );
+}
+
+void CompositeDataSource :: EmitChildren( Row & row ) {
 	for ( unsigned int i = 0; i < SourceCount(); i++ ) {
-		r.AppendRow( SourceAt( i )->Get() );
+		SourceAt( i )->Emit( row );
+	}
+}
+
+// emit a batch of n rows from each child in turn - if we have an order
+// the children's rows must be built separately and then re-ordered
+void CompositeDataSource :: EmitChildBatch( Rows & rows, unsigned int n ) {
+	if ( ! Ordered() ) {
+		for ( unsigned int i = 0; i < SourceCount(); i++ ) {
+			SourceAt( i )->EmitBatch( rows, n );
+		}
+		return;
+	}
+	mBatch.assign( n, Row() );
+	for ( unsigned int i = 0; i < SourceCount(); i++ ) {
+		SourceAt( i )->EmitBatch( mBatch, n );
+	}
+	for ( unsigned int i = 0; i < n; i++ ) {
+		rows[i].AppendRow( Order( mBatch[i] ) );
 	}
-	return Order( r );
 }
 
 // size is the recursive maximum of all child sources
@@ -129,8 +268,8 @@ void Intermediate :: SafePopulate() {
 	}
 }
 
-// get a row in random or sequential mode
-Row Intermediate :: Get() {
+// next stored row in random or sequential mode
+const Row & Intermediate :: Next() {
 
 	SafePopulate();
 
@@ -139,13 +278,26 @@ Row Intermediate :: Get() {
 	}
 
 	if ( ! mRand ) {
-		Row r = mRows[mPos++];
+		unsigned int i = mPos++;
 		mPos %= mRows.size();
-		return Order( r );
+		return mRows[i];
+	}
+	else {
+		return mRows[ Rand().Below( mRows.size() ) ];
+	}
+}
+
+Row Intermediate :: Get() {
+	return Order( Next() );
+}
+
+// stored rows are shared with the caller's row rather than copied
+void Intermediate :: Emit( Row & row ) {
+	if ( Ordered() ) {
+		row.AppendRow( Get() );
 	}
 	else {
-		int i = RNG::Random() % mRows.size();
-		return Order( mRows[i] );
+		row.AppendRef( Next() );
 	}
 }
 
@@ -161,9 +313,10 @@ void Intermediate :: Discard()  {
 	CompositeDataSource::Discard();
 }
 
-// derived classes use this to add their rows
+// derived classes use this to add their rows, which are stored flat
 void Intermediate :: AddRow( const Row & row ) {
 	mRows.push_back( row );
+	mRows.back().Flatten();
 }
 
 // pritected accessor needed for some derived functionality
@@ -235,8 +388,55 @@ class SourceBeast : public DMK::DataSource {
 		}
 };
 
+//----------------------------------------------------------------------------
+// Leaf that emits the number of beast as an integer cell
+//----------------------------------------------------------------------------
+
+class LeafBeast : public DMK::LeafSource {
+
+	public:
+
+		LeafBeast( const string & order = "" )
+			: DMK::LeafSource( FieldList( order ) ) {}
+
+		int Size() { return 1; }
+		void Reset() {}
+
+	protected:
+
+		void EmitCells( Row & row ) {
+			row.AppendInt( 666 );
+		}
+};
+
 //----------------------------------------------------------------------------
 
+// sources are named by where they are, not by how many came before
+DEFTEST( Scope ) {
+	string a, b, c;
+	{
+		SourceScope g( "gen(scopetest)" );
+		{
+			SourceScope s( "rand_int()" );
+			a = SourceScope::NextPath();
+			FAILNE( SourceScope::NextPath(), a + "#1" );
+		}
+		{
+			SourceScope s( "counter()" );
+			c = SourceScope::NextPath();
+		}
+		{
+			SourceScope s( "rand_int()" );
+			b = SourceScope::NextPath();
+		}
+	}
+	FAILNE( a, "/gen(scopetest)[0]/rand_int()[0]" );
+	FAILNE( b, "/gen(scopetest)[0]/rand_int()[1]" );
+	FAILNE( c, "/gen(scopetest)[0]/counter()[0]" );
+	FAILNE( RNG::StreamKey( a ), RNG::StreamKey( a ) );
+	FAILEQ( RNG::StreamKey( a ), RNG::StreamKey( b ) );
+}
+
 DEFTEST( Ctor ) {
 	SourceBeast b;
 	Row r = b.Get();
@@ -246,6 +446,17 @@ DEFTEST( Ctor ) {
 }
 
 
+DEFTEST( Batch ) {
+	SourceBeast b;
+	Rows rows;
+	b.GetBatch( rows, 10 );
+	FAILNE( rows.size(), 10 );
+	FAILNE( rows[9].Size(), 3 );
+	FAILNE( rows[9].At(2), "6" );
+	b.GetBatch( rows, 2 );
+	FAILNE( rows.size(), 2 );
+}
+
 DEFTEST( TestComposite ) {
 	DataSource * rs1 = new SourceBeast;
 	DataSource * rs2 = new SourceBeast;
@@ -259,6 +470,33 @@ DEFTEST( TestComposite ) {
 	FAILNE( r.At(5), "6" );
 }
 
+DEFTEST( LeafEmit ) {
+	LeafBeast b, ob( "1,1" );
+	Row r;
+	r.AppendValue( "x" );
+	b.Emit( r );
+	ob.Emit( r );
+	FAILNE( r.Size(), 4 );
+	FAILNE( r.Type(1), CELL_INT );
+	FAILNE( r.At(3), "666" );
+
+	Rows rows( 2, r );
+	ob.EmitBatch( rows, 2 );
+	FAILNE( rows[1].Size(), 6 );
+	FAILNE( rows[1].At(5), "666" );
+}
+
+DEFTEST( CompositeLeaf ) {
+	CompositeDataSource cs( FieldList( "4,1" ) );
+	cs.AddSource( new SourceBeast );
+	cs.AddSource( new LeafBeast );
+	Rows rows;
+	cs.GetBatch( rows, 3 );
+	FAILNE( rows[2].Size(), 2 );
+	FAILNE( rows[2].At(0), "666" );
+	FAILNE( rows[2].At(1), "6" );
+}
+
 
 #endif
 
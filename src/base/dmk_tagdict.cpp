@@ -71,11 +71,13 @@ DataSource * TagDictionary :: CreateDS( const ALib::XMLElement * e ) {
 	if ( it == mDSMap.end() ) {
 		throw Exception( "Unknown tag: " + name );
 	}
+	SourceScope scope( SourceScope::ElementName( e ) );
 	return it->second->CreateDS( e );
 }
 
 //----------------------------------------------------------------------------
-// create generator from XML
+// create generator from XML - its sources are keyed by the generator name
+// alone, so changing its other attributes doesn't change their values
 //----------------------------------------------------------------------------
 
 Generator * TagDictionary :: CreateGen( const ALib::XMLElement * e ) {
@@ -85,6 +87,7 @@ Generator * TagDictionary :: CreateGen( const ALib::XMLElement * e ) {
 	if ( it == mGenMap.end() ) {
 		throw Exception( "Unknown tag: " + name );
 	}
+	SourceScope scope( name + "(" + e->AttrValue( "name", "" ) + ")" );
 	return it->second->CreateGen( e );
 }
 
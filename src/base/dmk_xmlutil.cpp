@@ -11,6 +11,7 @@
 #include "dmk_strings.h"
 #include "dmk_fileman.h"
 #include "dmk_modman.h"
+#include "dmk_random.h"
 #include <iostream>
 #include <cstdarg>
 
@@ -235,6 +236,50 @@ bool GetRandom( const ALib::XMLElement * e, const string & defval ) {
 	return GetBool( e, RANDOM_ATTRIB, defval == "" ? YES_STR : defval );
 }
 
+//----------------------------------------------------------------------------
+// Get distribution named by "dist" attribute, with its "mean" and "sd".
+// Begin, end and mode belong to the tags' own distributions, so can't be
+// used with it. No "dist", or a "dist" of uniform, gives an empty spec.
+//----------------------------------------------------------------------------
+
+DistSpec GetDistSpec( const ALib::XMLElement * e ) {
+	string name = e->AttrValue( DIST_ATTRIB, "uniform" );
+	if ( name == "uniform" ) {
+		if ( e->HasAttr( MEAN_ATTRIB ) || e->HasAttr( SD_ATTRIB ) ) {
+			throw XMLError( ALib::SQuote( DIST_ATTRIB )
+								+ " needed for mean or sd", e );
+		}
+		return DistSpec();
+	}
+	if ( ! DistSpec::ValidName( name ) ) {
+		throw XMLError( "unknown distribution " + ALib::SQuote( name ), e );
+	}
+	if ( e->HasAttr( BEGIN_ATTRIB ) || e->HasAttr( END_ATTRIB )
+			|| e->HasAttr( "mode" ) ) {
+		throw XMLError( "begin, end and mode cannot be used with "
+							+ ALib::SQuote( DIST_ATTRIB ), e );
+	}
+	RequireAttrs( e, MEAN_ATTRIB );
+	double mean = GetReal( e, MEAN_ATTRIB );
+	double sd = 0;
+	if ( DistSpec::HasSD( name ) ) {
+		RequireAttrs( e, SD_ATTRIB );
+		sd = GetReal( e, SD_ATTRIB );
+	}
+	else if ( e->HasAttr( SD_ATTRIB ) ) {
+		throw XMLError( ALib::SQuote( SD_ATTRIB ) + " cannot be used with "
+							+ name + " distribution", e );
+	}
+
+	// the spec checks the parameters - the source makes the distribution
+	try {
+		return DistSpec( name, mean, sd );
+	}
+	catch( const Exception & ex ) {
+		throw XMLError( ex.what(), e );
+	}
+}
+
 //----------------------------------------------------------------------------
 // Get count of rows to output. The special symbol ALL_STR is used to
 // indicate that all rows are required.
@@ -31,6 +31,8 @@ class DSComposite : public CompositeDataSource {
 	public:
 
 		DSComposite( const FieldList & order = FieldList() );
+		void Emit( Row & row );
+		void EmitBatch( Rows & rows, unsigned int n );
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
 };
@@ -42,6 +44,21 @@ DSComposite :: DSComposite( const FieldList & order )
 }
 
 
+// plain composition lets its children write straight into the caller's
+// row, and can batch all its children at once
+void DSComposite :: Emit( Row & row ) {
+	if ( Ordered() ) {
+		row.AppendRow( Get() );
+	}
+	else {
+		EmitChildren( row );
+	}
+}
+
+void DSComposite :: EmitBatch( Rows & rows, unsigned int n ) {
+	EmitChildBatch( rows, n );
+}
+
 DataSource * DSComposite :: FromXML( const ALib::XMLElement * e ) {
 
 	RequireChildren( e );
@@ -97,6 +114,16 @@ DEFTEST( Nested ) {
 	FAILNE( r.At(3), "four" );
 }
 
+DEFTEST( Batch ) {
+	XMLPtr xml( XML2 );
+	DSComposite * p = (DSComposite *) DSComposite::FromXML( xml );
+	Rows rows;
+	p->GetBatch( rows, 3 );
+	FAILNE( rows.size(), 3 );
+	FAILNE( rows[2].Size(), 4 );
+	FAILNE( rows[2].At(3), "four" );
+}
+
 #endif
 
 //----------------------------------------------------------------------------
@@ -13,6 +13,7 @@
 #include "dmk_tagdict.h"
 #include "dmk_xmlutil.h"
 #include "dmk_strings.h"
+#include "dmk_types.h"
 
 using std::string;
 using std::vector;
@@ -27,18 +28,23 @@ const char * const COUNTER_TAG 		= "counter";
 // Counts each time used. Unlike int-seq, doesn't have  size.
 //----------------------------------------------------------------------------
 
-class DSCounter : public DataSource {
+class DSCounter : public LeafSource, public SeekableType {
 
 	public:
 
 		DSCounter( const FieldList & order,	int begin, int inc );
 
-		Row Get();
 		int Size();
 		void Reset();
+		void EmitAt( Row & row, unsigned long long i );
 
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
+	protected:
+
+		void EmitCells( Row & row );
+		void EmitCellBatch( Rows & rows, unsigned int n );
+
 	private:
 
 		int mBegin, mValue, mInc;
@@ -56,19 +62,37 @@ static RegisterDS <DSCounter> regrs1_( COUNTER_TAG );
 //----------------------------------------------------------------------------
 
 DSCounter :: DSCounter( const FieldList & order, int begin, int inc )
-	: DataSource( order ), mBegin( begin ), mValue( begin ), mInc( inc )  {
+	: LeafSource( order ), mBegin( begin ), mValue( begin ), mInc( inc )  {
 }
 
 //----------------------------------------------------------------------------
-// Return current value & increment
+// Return current value & increment. Values are stored as integers and
+// only formatted when output.
 //----------------------------------------------------------------------------
 
-Row DSCounter  :: Get() {
-	string ns = ALib::Str( mValue );
+void DSCounter :: EmitCells( Row & row ) {
+	row.AppendInt( mValue );
 	mValue += mInc;
-	return Order( Row( ns ) );
 }
 
+//----------------------------------------------------------------------------
+// Fill a block of values in one go
+//----------------------------------------------------------------------------
+
+void DSCounter :: EmitCellBatch( Rows & rows, unsigned int n ) {
+	for ( unsigned int i = 0; i < n; i++ ) {
+		rows[i].AppendInt( mValue );
+		mValue += mInc;
+	}
+}
+
+//----------------------------------------------------------------------------
+// The i'th value, wrapping round as repeated adds of the increment do
+//----------------------------------------------------------------------------
+
+void DSCounter :: EmitAt( Row & row, unsigned long long i ) {
+	row.AppendInt( int( (unsigned int) mBegin + (unsigned int) i * mInc ) );
+}
 
 //----------------------------------------------------------------------------
 // counters do not support sizing
@@ -122,6 +146,32 @@ DEFTEST( FromXML1 ) {
 	FAILNE( r.At(0), "101" );
 }
 
+DEFTEST( Batch ) {
+	string xml = "<counter begin='10' inc='2' />";
+	XMLPtr xp( xml );
+	DSCounter * c = (DSCounter *) DSCounter::FromXML( xp );
+	Rows rows;
+	c->GetBatch( rows, 3 );
+	FAILNE( rows.size(), 3 );
+	FAILNE( rows[0].At(0), "10" );
+	FAILNE( rows[2].At(0), "14" );
+	Row r = c->Get();
+	FAILNE( r.At(0), "16" );
+}
+
+DEFTEST( Seek ) {
+	string xml = "<counter begin='10' inc='-3' />";
+	XMLPtr xp( xml );
+	DSCounter * c = (DSCounter *) DSCounter::FromXML( xp );
+	Row r;
+	c->EmitAt( r, 0 );
+	c->EmitAt( r, 5 );
+	FAILNE( r.At(0), "10" );
+	FAILNE( r.At(1), "-5" );
+	FAILNE( c->Get().At(0), "10" );
+	delete c;
+}
+
 
 #endif
 
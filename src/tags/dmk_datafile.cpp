@@ -30,28 +30,38 @@ const char * const DATAFILE_TAG 	= "datafile";
 // Datafile class provides access to a CSV data file
 //----------------------------------------------------------------------------
 
-class DSDataFile : public DataSource {
+class DSDataFile : public LeafSource {
 
 	public:
 
 		DSDataFile( const std::string & filename,
 					bool random,
-					const FieldList & order );
+					const FieldList & order,
+					int freq = -1 );
 
-		Row Get();
 		int Size();
 		void Discard();
 		void Reset();
 
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
+	protected:
+
+		void EmitCells( Row & row );
+		void EmitCellBatch( Rows & rows, unsigned int n );
+
 	private:
 
 		void Populate();
+		void ReadFreqs();
+		const Row & Next();
 		string mFilename;
 		unsigned int mPos;
 		bool mRandom;
-		Strings mLines;
+		int mFreq;
+		Rows mRows;
+		AliasTable mFreqs;
+		std::vector <unsigned int> mPicks;
 
 };
 
@@ -63,31 +73,59 @@ static RegisterDS <DSDataFile> regrs1_( DATAFILE_TAG );
 
 //----------------------------------------------------------------------------
 // Create from filename, which is currently relative to the data directory
-// in the distribution root.
+// in the distribution root. If freq is a column index, that column holds
+// the weight of each record.
 //----------------------------------------------------------------------------
 
 DSDataFile :: DSDataFile( const string & filename,
 							bool random,
-							const FieldList & order )
-	: DataSource( order ), mFilename( filename ),
-		mPos( 0 ), mRandom( random ) {
+							const FieldList & order,
+							int freq )
+	: LeafSource( order ), mFilename( filename ),
+		mPos( 0 ), mRandom( random ), mFreq( freq ) {
 }
 
 //----------------------------------------------------------------------------
-// Read into memory if not already read then select record either at random
-// or using current position.
+// Select record either at random or using current position. The records
+// are parsed once when read, so this just shares the stored row.
 //----------------------------------------------------------------------------
 
-Row DSDataFile :: Get() {
-	Populate();
-	if ( mRandom ) {
-		Row r( mLines[ RNG::Random() % mLines.size() ] );
-		return Order( r );
+const Row & DSDataFile :: Next() {
+	if ( mRandom && mFreqs.Size() ) {
+		return mRows[ mFreqs.Pick( Rand() ) ];
+	}
+	else if ( mRandom ) {
+		return mRows[ Rand().Below( mRows.size() ) ];
 	}
 	else {
-		Row r( mLines[ mPos++ ] );
-		mPos %= mLines.size();
-		return Order( r );
+		const Row & r = mRows[ mPos++ ];
+		mPos %= mRows.size();
+		return r;
+	}
+}
+
+//----------------------------------------------------------------------------
+// Read into memory if not already read then add one or more records to
+// the caller's rows - the records are referred to rather than copied.
+//----------------------------------------------------------------------------
+
+void DSDataFile :: EmitCells( Row & row ) {
+	Populate();
+	row.AppendRef( Next() );
+}
+
+void DSDataFile :: EmitCellBatch( Rows & rows, unsigned int n ) {
+	Populate();
+	if ( mRandom && ! mFreqs.Size() ) {
+		mPicks.resize( n );
+		Rand().FillBelow( mRows.size(), &mPicks[0], n );
+		for ( unsigned int i = 0; i < n; i++ ) {
+			rows[i].AppendRef( mRows[ mPicks[i] ] );
+		}
+		return;
+	}
+	for ( unsigned int i = 0; i < n; i++ ) {
+		rows[i].AppendRef( Next() );
 	}
 }
 
@@ -97,7 +135,7 @@ Row DSDataFile :: Get() {
 
 int DSDataFile :: Size() {
 	Populate();
-	return mLines.size();
+	return mRows.size();
 }
 
 //----------------------------------------------------------------------------
@@ -109,11 +147,11 @@ void DSDataFile :: Reset() {
 }
 
 //----------------------------------------------------------------------------
-// no longer need lines
+// no longer need rows
 //----------------------------------------------------------------------------
 
 void DSDataFile :: Discard() {
-	mLines.clear();
+	mRows.clear();
 }
 
 //----------------------------------------------------------------------------
@@ -121,7 +159,7 @@ void DSDataFile :: Discard() {
 //----------------------------------------------------------------------------
 
 void DSDataFile :: Populate() {
-	if ( mLines.size() ) {
+	if ( mRows.size() ) {
 		return;
 	}
 
@@ -140,31 +178,68 @@ void DSDataFile :: Populate() {
 	string line;
 	while( std::getline( ifs, line ) ) {
 		if ( ! ALib::IsEmpty( line ) ) {
-			mLines.push_back( line );
+			mRows.push_back( Row( line ) );
 		}
 	}
 
-	if ( mLines.size() == 0 ) {
+	if ( mRows.size() == 0 ) {
 		throw Exception( "File " + mFilename + " is empty" );
 	}
+	if ( mFreq >= 0 ) {
+		ReadFreqs();
+	}
+}
+
+//----------------------------------------------------------------------------
+// Take the weights out of the frequency column and build the table used
+// to pick records with. Weights needn't be percentages, but can't all be
+// zero.
+//----------------------------------------------------------------------------
+
+void DSDataFile :: ReadFreqs() {
+	vector <double> weights( mRows.size() );
+	double sum = 0;
+	for ( unsigned int i = 0; i < mRows.size(); i++ ) {
+		Row & r = mRows[i];
+		if ( (int) r.Size() <= mFreq || ! ALib::IsNumber( r.At( mFreq ) ) ) {
+			throw Exception( "No valid frequency value in record "
+								+ ALib::Str( i + 1 ) + " of " + mFilename );
+		}
+		weights[i] = ALib::ToReal( r.At( mFreq ) );
+		if ( weights[i] < 0 ) {
+			throw Exception( "Negative frequency value in record "
+								+ ALib::Str( i + 1 ) + " of " + mFilename );
+		}
+		r.Erase( mFreq );
+		sum += weights[i];
+	}
+	if ( sum <= 0 ) {
+		throw Exception( "Frequencies in " + mFilename + " are all zero" );
+	}
+	mFreqs.Build( weights );
 }
 
 //----------------------------------------------------------------------------
-// Attribute "values" can contain comma-separated list of values. More
-// values can also be specified as lines of text content.
+// Attribute "file" names the file to read. Attribute "freq" is the 1-based
+// column holding record weights, which is not output.
 //----------------------------------------------------------------------------
 
 DataSource * DSDataFile :: FromXML( const ALib::XMLElement * e ) {
 
 	ForbidChildren( e );
 	RequireAttrs( e, FILE_ATTRIB );
-	AllowAttrs( e, AttrList( FILE_ATTRIB, ORDER_ATTRIB, RANDOM_ATTRIB, 0 ));
+	AllowAttrs( e, AttrList( FILE_ATTRIB, ORDER_ATTRIB,
+								RANDOM_ATTRIB, FREQ_ATTRIB, 0 ));
 
 	string f = e->AttrValue( FILE_ATTRIB );
 	bool random = GetRandom( e );
 	FieldList order = GetOrder( e );
+	int freq = GetInt( e, FREQ_ATTRIB, "0" ) - 1;
+	if ( freq < -1 ) {
+		throw XMLError( "Invalid frequency column", e );
+	}
 
-	std::auto_ptr <DSDataFile> df( new DSDataFile( f, random, order ) );
+	std::auto_ptr <DSDataFile> df( new DSDataFile( f, random, order, freq ) );
 	return df.release();
 }
 
@@ -179,6 +254,7 @@ DataSource * DSDataFile :: FromXML( const ALib::XMLElement * e ) {
 #ifdef DMK_TEST
 
 #include "a_myth.h"
+#include <cstdio>
 using namespace ALib;
 using namespace DMK;
 
@@ -197,6 +273,28 @@ DEFTEST( digits ) {
 	FAILNE( r.At(1), "one" );
 }
 
+// weight column is dropped, and zero weights never picked
+DEFTEST( Freq ) {
+	const char * const FNAME = "./dmk_freq_test.dat";
+	std::ofstream ofs( FNAME );
+	ofs << "foo,1.5\nbar,0\nbaz,0.5\n";
+	ofs.close();
+	string XML = string( "<datafile file='" ) + FNAME
+					+ "' random='yes' freq='2' />";
+	XMLPtr xml( XML );
+	DSDataFile * df = (DSDataFile*) DSDataFile::FromXML( xml );
+	FAILNE( df->Size(), 3 );
+	int foo = 0;
+	for ( unsigned int i = 0; i < 2000; i++ ) {
+		Row r = df->Get();
+		FAILNE( r.Size(), 1 );
+		FAILEQ( r.At(0), "bar" );
+		foo += r.At(0) == "foo";
+	}
+	std::remove( FNAME );
+	FAILEQ( foo < 1400 || foo > 1600, true );
+}
+
 #endif
 
 //----------------------------------------------------------------------------
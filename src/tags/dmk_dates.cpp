@@ -16,6 +16,7 @@
 #include "dmk_xmlutil.h"
 #include "dmk_strings.h"
 #include "dmk_random.h"
+#include "dmk_types.h"
 
 using std::string;
 using std::vector;
@@ -41,7 +42,7 @@ const char * const YEAR_INCTYPE 	= "years";
 // Serquential dates, incremented by day
 //----------------------------------------------------------------------------
 
-class DSDateSeq : public DataSource {
+class DSDateSeq : public LeafSource, public SequenceType {
 
 	public:
 
@@ -51,14 +52,21 @@ class DSDateSeq : public DataSource {
 					unsigned int inc,
 					const string & inctype );
 
-		Row Get();
 		int Size();
 		void Reset();
+		bool Indexable() const;
+		void EmitAt( Row & row, unsigned long long i );
 
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
+	protected:
+
+		void EmitCells( Row & row );
+
 	private:
 
+		ALib::Date DateAt( unsigned int i ) const;
+
 		ALib::Date mBegin, mNow, mEnd;
 		unsigned int mInc;
 		string mIncType;
@@ -68,7 +76,7 @@ class DSDateSeq : public DataSource {
 // Random dates
 //----------------------------------------------------------------------------
 
-class DSRandomDate : public DataSource {
+class DSRandomDate : public LeafSource {
 
 	public:
 
@@ -83,18 +91,31 @@ class DSRandomDate : public DataSource {
 
 		~DSRandomDate();
 
-		Row Get();
 		int Size();
 		void Reset() {} 	// does nothing
 
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
+	protected:
+
+		void EmitCells( Row & row );
+		void EmitCellBatch( Rows & rows, unsigned int n );
+
 	private:
 
 		ALib::Date mBegin;
 		Distribution * mDist;
+		std::vector <int> mDays;
 };
 
+//----------------------------------------------------------------------------
+// Rows hold dates natively, not as strings
+//----------------------------------------------------------------------------
+
+static void AppendDate( Row & row, const ALib::Date & d ) {
+	row.AppendDate( d.Year(), d.Month(), d.Day() );
+}
+
 //----------------------------------------------------------------------------
 // Register tags
 //----------------------------------------------------------------------------
@@ -113,7 +134,7 @@ DSDateSeq :: DSDateSeq( const FieldList & order,
 							unsigned int inc,
 							const string & inctype )
 
-	: DataSource( order ), mBegin( begin ), mNow( begin), mEnd( end ),
+	: LeafSource( order ), mBegin( begin ), mNow( begin), mEnd( end ),
 		mInc( inc ), mIncType( inctype ) {
 }
 
@@ -122,11 +143,11 @@ DSDateSeq :: DSDateSeq( const FieldList & order,
 // ???Need to fix increment???
 //----------------------------------------------------------------------------
 
-Row DSDateSeq :: Get() {
+void DSDateSeq :: EmitCells( Row & row ) {
 	if ( mNow > mEnd && mBegin != mEnd ) {
 		mNow = mBegin;
 	}
-	Row r( mNow.Str() );
+	AppendDate( row, mNow );
 	if ( mIncType == DAY_INCTYPE ) {
 		mNow += mInc;
 	}
@@ -140,22 +161,52 @@ Row DSDateSeq :: Get() {
 	else if ( mIncType == YEAR_INCTYPE ) {
 		mNow = ALib::Date( mNow.Year() + mInc, mNow.Month(), mNow.Day() );
 	}
-	return Order( r );
 }
 
 //----------------------------------------------------------------------------
-// need to take inctype into account for size
+// Date i steps from the beginning, matching the steps EmitCells() takes
+//----------------------------------------------------------------------------
+
+ALib::Date DSDateSeq :: DateAt( unsigned int i ) const {
+	if ( mIncType == YEAR_INCTYPE ) {
+		return ALib::Date( mBegin.Year() + i * mInc, mBegin.Month(),
+								mBegin.Day() );
+	}
+	int days = mIncType == WEEK_INCTYPE ? 7
+				: (mIncType == MONTH_INCTYPE ? 28 : 1);
+	return ALib::Date::Add( mBegin, i * mInc * days );
+}
+
+// with no end the sequence never wraps, so has no cycle to index
+bool DSDateSeq :: Indexable() const {
+	return mBegin != mEnd;
+}
+
+void DSDateSeq :: EmitAt( Row & row, unsigned long long i ) {
+	AppendDate( row, DateAt( i % Size() ) );
+}
+
+//----------------------------------------------------------------------------
+// Size is the number of steps taken before passing the end, so takes the
+// increment type into account
 //----------------------------------------------------------------------------
 
 int DSDateSeq :: Size() {
 	if ( mBegin == mEnd ) {
 		return 1;
 	}
+	int n;
+	if ( mIncType == YEAR_INCTYPE ) {
+		n = 1 + (mEnd.Year() - mBegin.Year()) / mInc;
+		if ( DateAt( n - 1 ) > mEnd ) {
+			n--;
+		}
+	}
 	else {
-		// ??? not correct ??
-		int diff = 1 + ALib::Date::Diff( mEnd, mBegin ) / mInc;
-		return diff;
+		int step = ALib::Date::Diff( DateAt( 1 ), mBegin );
+		n = 1 + ALib::Date::Diff( mEnd, mBegin ) / step;
 	}
+	return n;
 }
 
 void DSDateSeq :: Reset() {
@@ -207,10 +258,10 @@ DataSource * DSDateSeq :: FromXML( const ALib::XMLElement * e ) {
 DSRandomDate :: DSRandomDate( const FieldList & order,
 								const ALib::Date & begin,
 								const ALib::Date & end )
-	: DataSource( order ), mBegin( begin ), mDist( 0 ) {
+	: LeafSource( order ), mBegin( begin ), mDist( 0 ) {
 
 	int iend = ALib::Date::Diff( end, begin );
-	 mDist = new UniformDist( 0,  iend );
+	 mDist = new UniformDist( Rand(), 0,  iend );
 }
 
 
@@ -222,11 +273,11 @@ DSRandomDate :: DSRandomDate( const FieldList & order,
 								const ALib::Date & begin,
 								const ALib::Date & end,
 								const ALib::Date & mode )
-	: DataSource( order ), mBegin( begin ), mDist( 0 ) {
+	: LeafSource( order ), mBegin( begin ), mDist( 0 ) {
 
 	int iend = ALib::Date::Diff( end, begin );
 	int imode = ALib::Date::Diff( mode, begin );
-	 mDist = new TriangleDist( 0, imode, iend );
+	 mDist = new TriangleDist( Rand(), 0, imode, iend );
 }
 
 //----------------------------------------------------------------------------
@@ -241,9 +292,20 @@ DSRandomDate :: ~DSRandomDate() {
 // Next random date
 //----------------------------------------------------------------------------
 
-Row DSRandomDate :: Get() {
-	ALib::Date dt = ALib::Date::Add( mBegin, mDist->NextInt() );
-	return Order( Row( dt.Str() ) );
+void DSRandomDate :: EmitCells( Row & row ) {
+	AppendDate( row, ALib::Date::Add( mBegin, mDist->NextInt() ) );
+}
+
+//----------------------------------------------------------------------------
+// Block of random dates - day offsets are made in one go
+//----------------------------------------------------------------------------
+
+void DSRandomDate :: EmitCellBatch( Rows & rows, unsigned int n ) {
+	mDays.resize( n );
+	mDist->FillInt( &mDays[0], n );
+	for ( unsigned int i = 0; i < n; i++ ) {
+		AppendDate( rows[i], ALib::Date::Add( mBegin, mDays[i] ) );
+	}
 }
 
 //----------------------------------------------------------------------------
@@ -15,8 +15,12 @@
 #include "dmk_xmlutil.h"
 #include "dmk_strings.h"
 #include "dmk_fileman.h"
+#include "dmk_modman.h"
+#include "dmk_sort.h"
+#include "dmk_types.h"
 #include <set>
 #include <memory>
+#include <algorithm>
 
 using std::string;
 using std::vector;
@@ -30,8 +34,57 @@ const char * const NAME_ATTR 	= "name";
 const char * const HIDE_ATTR 	= "hide";
 const char * const FNAMES_ATTR = "fields";
 const char * const GROUP_ATTR  = "group";
+const char * const THREADS_ATTR = "threads";
+const char * const GROUPMEM_ATTR = "groupmem";
+
+//----------------------------------------------------------------------------
+// Number of rows pulled from the sources at a time
+//----------------------------------------------------------------------------
+
+const unsigned int GEN_BATCH	= 1024;
+
+//----------------------------------------------------------------------------
+// Memory in megabytes rows being grouped may use before they are sorted
+// on disk instead, by default and at most.
+//----------------------------------------------------------------------------
+
+const int GROUP_MEM = 256;
+const int MAX_GROUP_MEM = 4095;
 
 
+//----------------------------------------------------------------------------
+// Makes the rows of a seekable generator by having each source emit its
+// i'th value, for the parallel writer's threads. Each source emits its
+// first value here, so anything it sets up on first use, like a shuffle's
+// key, is set up before the threads start.
+//----------------------------------------------------------------------------
+
+class SeekMaker : public RowMaker {
+
+	public:
+
+		SeekMaker( const Generator & g );
+		void MakeRow( Row & row, unsigned long long i ) const;
+
+	private:
+
+		std::vector <SeekableType *> mSources;
+};
+
+SeekMaker :: SeekMaker( const Generator & g ) {
+	Row r;
+	for ( unsigned int i = 0; i < g.SourceCount(); i++ ) {
+		mSources.push_back( AsSeekable( g.SourceAt( i ) ) );
+		mSources.back()->EmitAt( r, 0 );
+	}
+}
+
+void SeekMaker :: MakeRow( Row & row, unsigned long long i ) const {
+	for ( unsigned int j = 0; j < mSources.size(); j++ ) {
+		mSources[j]->EmitAt( row, i );
+	}
+}
+
 //----------------------------------------------------------------------------
 
 class GeneratorTag : public Generator {
@@ -42,7 +95,9 @@ class GeneratorTag : public Generator {
 						int count, bool debug,
 						const std::string & ofn,
 						const std::string & fields,
-						const FieldList & grp );
+						const FieldList & grp,
+						unsigned int nthreads,
+						unsigned int groupmem );
 
 		void Generate( Model * model );
 		bool Hide() const;
@@ -51,10 +106,17 @@ class GeneratorTag : public Generator {
 
 	private:
 
+		void Write( OutputSink & out, Rows & batch, unsigned int n,
+						ParallelWriter * pw );
+		void WriteSorted( OutputSink & out, RowSorter & sorter,
+						ParallelWriter * pw );
+
 		int mCount;
 		bool mHide;
 		std::string mOutFile;
 		ALib::CommaList mFields;
+		unsigned int mThreads;
+		unsigned int mGroupMem;
 
 };
 
@@ -72,27 +134,57 @@ GeneratorTag :: GeneratorTag( const string & name,
 								int count, bool debug,
 								const string &  ofn,
 								const string & fields,
-								const FieldList & grp  )
+								const FieldList & grp,
+								unsigned int nthreads,
+								unsigned int groupmem )
 	: Generator( name, debug, grp ),
-		mCount( count ),  mOutFile( ofn ), mFields( fields ) {
+		mCount( count ),  mOutFile( ofn ), mFields( fields ),
+		mThreads( nthreads ), mGroupMem( groupmem ) {
 }
 
 //----------------------------------------------------------------------------
 // generate the data. if the user wants "all rows" we need to]
 // send a "size" message to all children to find how many rows to produce.
+// Rows are pulled from the sources in batches rather than one at a time,
+// and written to the sink for the output file without being copied.
+// Hidden output is never formatted - the rows are only kept for recall.
+// Rows are only kept if something refers to this generator by name and
+// they can't be made again by seeking the sources, otherwise memory use
+// doesn't grow with size - grouped rows that are not kept are sorted by a
+// RowSorter, which spills to disk when they exceed the group memory
+// budget, and hidden ones are not sorted at all. Hidden seekable rows
+// are not even generated until something asks for them.
+// With more than one thread, the rows of a seekable generator are split
+// into ranges that are made and formatted on the other threads, and are
+// written in order. Other generators' rows are still made on this thread,
+// as their sources must emit their values in order, but are formatted by
+// the others. Either way the output is the same as with one thread.
 //----------------------------------------------------------------------------
 
 void GeneratorTag :: Generate( Model * model ) {
 
-	std::ostream & os = FileManager::Instance().GetStream( mOutFile );
+	OutputSink & out = FileManager::Instance().GetSink( mOutFile );
+	bool hidden = mOutFile == FileManager::Instance().HideName();
+	bool ref = ModelManager::Instance()->IsGenRef( model->Name(), Name() );
+	bool keep = ref && ! Seekable();
+	std::auto_ptr <RowSorter> sorter(
+		HasGroup() && ! keep && ! hidden
+			? new RowSorter( Group(), mGroupMem * 1024 * 1024 ) : 0
+	);
 	int nrows = mCount < 0 ? GetSize() : mCount;
+	if ( ref && ! keep ) {
+		SetSeekRows( nrows );
+		if ( hidden ) {
+			nrows = 0;
+		}
+	}
 	bool debug = false; // model->Debug() || Debug();
 
 	if ( debug ) {
 		std::cerr << "----- begin " << Name() << "\n";
 	}
 
-	if ( mFields.Size() ) {
+	if ( mFields.Size() && ! hidden ) {
 		Row r;
 		for ( unsigned int i = 0; i < mFields.Size(); i++ ) {
 			r.AppendValue( mFields.At( i ) );
@@ -100,32 +192,106 @@ void GeneratorTag :: Generate( Model * model ) {
 		if ( debug ) {
 			DebugRow( r, std::cerr );
 		}
-		os << r.AsCSV() << "\n";
+		out.Write( r );
 	}
 
-	while( nrows-- ) {
-		Row r = Get();
-		if ( debug ) {
-			DebugRow( r, std::cerr );
+	std::auto_ptr <ParallelWriter> pw(
+		mThreads > 1 && ! hidden ? new ParallelWriter( out, mThreads - 1 ) : 0
+	);
+
+	if ( pw.get() && ! keep && Seekable() ) {
+		SeekMaker maker( *this );
+		for ( int i = 0; i < nrows; i += GEN_BATCH ) {
+			pw->Write( maker, i, std::min( (unsigned int) (nrows - i), GEN_BATCH ) );
+		}
+		pw->Finish();
+		nrows = 0;
+	}
+
+	Rows batch;
+	while( nrows > 0 ) {
+		unsigned int n = std::min( (unsigned int) nrows, GEN_BATCH );
+		GetBatch( batch, n );
+		for ( unsigned int i = 0; i < n; i++ ) {
+			const Row & r = batch[i];
+			if ( debug ) {
+				DebugRow( r, std::cerr );
+			}
+			if ( keep ) {
+				AddRow( r );
+			}
+			else if ( sorter.get() ) {
+				sorter->Add( r );
+			}
 		}
-		if ( ! HasGroup() ) {
-			os << r.AsCSV() << "\n";
+		if ( ! HasGroup() && ! hidden ) {
+			Write( out, batch, n, pw.get() );
 		}
-		AddRow( r );
+		nrows -= n;
 	}
 
-	if ( HasGroup() ) {
+	if ( sorter.get() ) {
+		WriteSorted( out, *sorter, pw.get() );
+	}
+	else if ( HasGroup() && keep ) {
 		DoGroup();
-		for ( int i = 0; i < Size(); i++ ) {
-			os << RowAt(i).AsCSV() << "\n";
+		for ( int i = 0; i < Size() && ! hidden; i += GEN_BATCH ) {
+			unsigned int n = std::min( (unsigned int) (Size() - i), GEN_BATCH );
+			batch.assign( n, Row() );
+			for ( unsigned int j = 0; j < n; j++ ) {
+				batch[j] = RowAt( i + j );
+			}
+			Write( out, batch, n, pw.get() );
 		}
 	}
 
+	if ( pw.get() ) {
+		pw->Finish();
+	}
+
 	if ( debug ) {
 		std::cerr << "----- end   " << Name() << "\n";
 	}
 }
 
+//----------------------------------------------------------------------------
+// Write batch of rows directly, or via the thread pool if there is one
+//----------------------------------------------------------------------------
+
+void GeneratorTag :: Write( OutputSink & out, Rows & batch, unsigned int n,
+								ParallelWriter * pw ) {
+	if ( pw ) {
+		pw->Write( batch, n );
+	}
+	else {
+		for ( unsigned int i = 0; i < n; i++ ) {
+			out.Write( batch[i] );
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+// Write rows grouped by the sorter, a batch at a time. The parallel writer
+// may hand back a batch of a different size.
+//----------------------------------------------------------------------------
+
+void GeneratorTag :: WriteSorted( OutputSink & out, RowSorter & sorter,
+									ParallelWriter * pw ) {
+	sorter.Sort();
+	Rows batch( GEN_BATCH );
+	unsigned int n = 0;
+	while( sorter.Next( batch[n] ) ) {
+		if ( ++n == GEN_BATCH ) {
+			Write( out, batch, n, pw );
+			batch.resize( GEN_BATCH );
+			n = 0;
+		}
+	}
+	if ( n ) {
+		Write( out, batch, n, pw );
+	}
+}
+
 //----------------------------------------------------------------------------
 // Should the output from this generator be displayed?
 //----------------------------------------------------------------------------
@@ -140,7 +306,8 @@ Generator * GeneratorTag :: FromXML( const ALib::XMLElement * e ) {
 	RequireChildren( e );
 	AllowAttrs( e, AttrList( NAME_ATTR, COUNT_ATTRIB, GROUP_ATTR,
 								DEBUG_ATTRIB, HIDE_ATTR,
-								OUT_ATTRIB, FNAMES_ATTR, 0 ) );
+								OUT_ATTRIB, FNAMES_ATTR, THREADS_ATTR,
+								GROUPMEM_ATTR, 0 ) );
 	string name = e->HasAttr( NAME_ATTR) ? e->AttrValue( NAME_ATTR ) : "";
 
 	int count = GetCount( e );
@@ -148,8 +315,23 @@ Generator * GeneratorTag :: FromXML( const ALib::XMLElement * e ) {
 	FieldList grp( e->AttrValue( GROUP_ATTR, "" ));
 	string ofn = GetOutputFile( e );
 	string fields = e->AttrValue( FNAMES_ATTR, "" );
+	int nthreads = e->HasAttr( THREADS_ATTR )
+						? GetInt( e, THREADS_ATTR )
+						: ModelManager::Instance()->CommandLineThreads();
+	if ( nthreads < 1 ) {
+		throw XMLError( ALib::SQuote( THREADS_ATTR )
+							+ " must be at least 1", e );
+	}
+	int groupmem = e->HasAttr( GROUPMEM_ATTR )
+						? GetInt( e, GROUPMEM_ATTR )
+						: GROUP_MEM;
+	if ( groupmem < 1 || groupmem > MAX_GROUP_MEM ) {
+		throw XMLError( ALib::SQuote( GROUPMEM_ATTR ) + " must be between 1 and "
+							+ ALib::Str( MAX_GROUP_MEM ), e );
+	}
 	std::auto_ptr <GeneratorTag> g(
-		new GeneratorTag( name, count, debug, ofn, fields, grp )
+		new GeneratorTag( name, count, debug, ofn, fields, grp,
+							nthreads, groupmem )
 	);
 	g->AddSources( e );
 	return g.release();
@@ -49,7 +49,7 @@ class Group : public CompositeDataSource {
 	private:
 
 		void DoReset();
-		Row GetNonGroup();
+		void EmitNonGroup( Row & row );
 		void DoSort();
 
 		FieldList  mFields, mReset;
@@ -84,15 +84,13 @@ int Group :: Size() {
 }
 
 //----------------------------------------------------------------------------
-// Get a rowe from sources not part of group
+// Add values from sources not part of group
 //----------------------------------------------------------------------------
 
-Row Group :: GetNonGroup() {
-	Row r;
+void Group :: EmitNonGroup( Row & row ) {
 	for ( unsigned int i = 1; i < SourceCount(); i++ ) {
-		r.AppendRow( SourceAt(i)->Get() );
+		SourceAt(i)->Emit( row );
 	}
-	return r;
 }
 
 //----------------------------------------------------------------------------
@@ -145,7 +143,7 @@ Row Group :: Get() {
 		mLast = gr;
 	}
 
-	gr.AppendRow( GetNonGroup() );
+	EmitNonGroup( gr );
 	return Order( gr );
 }
 
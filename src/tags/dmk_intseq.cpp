@@ -17,6 +17,7 @@
 #include "dmk_types.h"
 
 #include <cmath>
+#include <climits>
 
 using std::string;
 using std::vector;
@@ -34,45 +35,61 @@ const char * const MODE_ATTR 		= "mode";
 // Sequential integers
 //----------------------------------------------------------------------------
 
-class DSIntSeq : public DataSource, public SequenceType {
+class DSIntSeq : public LeafSource, public SequenceType {
 
 	public:
 
 		DSIntSeq( const FieldList & order,	int begin, int end, int inc );
 
-		Row Get();
 		int Size();
 		void Reset();
+		void EmitAt( Row & row, unsigned long long i );
 
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
+	protected:
+
+		void EmitCells( Row & row );
+		void EmitCellBatch( Rows & rows, unsigned int n );
+
 	private:
 
+		int Next();
+
 		int mBegin, mNow, mEnd, mInc;
 };
 
 //----------------------------------------------------------------------------
-// Random integers. Now support uniform & triangular distributions.
+// Random integers. Now support uniform & triangular distributions, and
+// any named by a dist attribute, whose values are rounded.
 //----------------------------------------------------------------------------
 
-class DSRandInt : public DataSource {
+class DSRandInt : public LeafSource {
 
 	public:
 
 		DSRandInt( const FieldList & order,	int begin, int end );
 		DSRandInt( const FieldList & order,	int begin, int end, int mode );
+		DSRandInt( const FieldList & order,	const DistSpec & ds );
 
 		~DSRandInt();
 
-		Row Get();
 		int Size();
         void Reset() {} 	// does nothing
 
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
+	protected:
+
+		void EmitCells( Row & row );
+		void EmitCellBatch( Rows & rows, unsigned int n );
+
 	private:
 
 		Distribution * mDist;
+		bool mRound;
+		std::vector <int> mValues;
+		std::vector <double> mReals;
 };
 
 //----------------------------------------------------------------------------
@@ -87,7 +104,7 @@ static RegisterDS <DSRandInt> regrs2_( RANDINT_TAG );
 //----------------------------------------------------------------------------
 
 DSIntSeq :: DSIntSeq( const FieldList & order, int begin, int end, int inc )
-	: DataSource( order ),
+	: LeafSource( order ),
 		mBegin( begin ), mNow( begin ), mEnd( end), mInc( inc )  {
 }
 
@@ -96,8 +113,8 @@ DSIntSeq :: DSIntSeq( const FieldList & order, int begin, int end, int inc )
 // whether we are going up or down.
 //----------------------------------------------------------------------------
 
-Row DSIntSeq  :: Get() {
-	string ns = ALib::Str( mNow );
+int DSIntSeq  :: Next() {
+	int n = mNow;
 	if ( mInc > 0 ) {
 		if ( mNow + mInc > mEnd ) {
 			mNow = mBegin;
@@ -114,8 +131,29 @@ Row DSIntSeq  :: Get() {
 			mNow += mInc;
 		}
 	}
+	return n;
+}
+
+//----------------------------------------------------------------------------
+// Single value and block of values both use Next() to step the sequence
+//----------------------------------------------------------------------------
+
+void DSIntSeq  :: EmitCells( Row & row ) {
+	row.AppendInt( Next() );
+}
+
+void DSIntSeq  :: EmitCellBatch( Rows & rows, unsigned int n ) {
+	for ( unsigned int i = 0; i < n; i++ ) {
+		rows[i].AppendInt( Next() );
+	}
+}
 
-	return Order( Row( ns ) );
+//----------------------------------------------------------------------------
+// Value i of the cycle
+//----------------------------------------------------------------------------
+
+void DSIntSeq :: EmitAt( Row & row, unsigned long long i ) {
+	row.AppendInt( mBegin + (long long) ( i % Size() ) * mInc );
 }
 
 //----------------------------------------------------------------------------
@@ -164,13 +202,13 @@ DataSource * DSIntSeq :: FromXML( const ALib::XMLElement * e ) {
 //----------------------------------------------------------------------------
 
 DSRandInt :: DSRandInt( const FieldList & order, int begin, int end )
-	: DataSource( order ), mDist( 0 ) {
+	: LeafSource( order ), mDist( 0 ), mRound( false ) {
 
 	if ( begin == end ) {
-		mDist = new UniformDist( 0, INT_MAX);
+		mDist = new UniformDist( Rand(), 0, INT_MAX);
 	}
 	else {
-		mDist = new UniformDist( begin, end );
+		mDist = new UniformDist( Rand(), begin, end );
 	}
 }
 
@@ -179,7 +217,31 @@ DSRandInt :: DSRandInt( const FieldList & order, int begin, int end )
 //----------------------------------------------------------------------------
 
 DSRandInt :: DSRandInt( const FieldList & order, int begin, int end, int mode )
-	: DataSource( order ), 	mDist( new TriangleDist( begin, mode, end )  ) {
+	: LeafSource( order ), 	mDist( new TriangleDist( Rand(), begin, mode, end )  ),
+		mRound( false ) {
+}
+
+//----------------------------------------------------------------------------
+// Distribution given by name
+//----------------------------------------------------------------------------
+
+DSRandInt :: DSRandInt( const FieldList & order, const DistSpec & ds )
+	: LeafSource( order ), mDist( ds.Make( Rand() ) ), mRound( true ) {
+}
+
+//----------------------------------------------------------------------------
+// Nearest integer, clamped to what a row can hold
+//----------------------------------------------------------------------------
+
+static long long Round( double d ) {
+	d = std::floor( d + 0.5 );
+	if ( d >= 9.2e18 ) {
+		return LLONG_MAX;
+	}
+	else if ( d <= -9.2e18 ) {
+		return LLONG_MIN;
+	}
+	return (long long) d;
 }
 
 //----------------------------------------------------------------------------
@@ -194,8 +256,33 @@ DSRandInt :: ~DSRandInt() {
 // Not a lot to do here any more...
 //----------------------------------------------------------------------------
 
-Row DSRandInt :: Get() {
-	return Order( Row( ALib::Str( mDist->NextInt() ) ) );
+void DSRandInt :: EmitCells( Row & row ) {
+	if ( mRound ) {
+		row.AppendInt( Round( mDist->NextReal() ) );
+	}
+	else {
+		row.AppendInt( mDist->NextInt() );
+	}
+}
+
+//----------------------------------------------------------------------------
+// Block of random values - the distribution makes them all in one go
+//----------------------------------------------------------------------------
+
+void DSRandInt :: EmitCellBatch( Rows & rows, unsigned int n ) {
+	if ( mRound ) {
+		mReals.resize( n );
+		mDist->FillReal( &mReals[0], n );
+		for ( unsigned int i = 0; i < n; i++ ) {
+			rows[i].AppendInt( Round( mReals[i] ) );
+		}
+		return;
+	}
+	mValues.resize( n );
+	mDist->FillInt( &mValues[0], n );
+	for ( unsigned int i = 0; i < n; i++ ) {
+		rows[i].AppendInt( mValues[i] );
+	}
 }
 
 //----------------------------------------------------------------------------
@@ -214,7 +301,12 @@ int DSRandInt :: Size() {
 DataSource * DSRandInt :: FromXML( const ALib::XMLElement * e ) {
 	ForbidChildren( e );
 	AllowAttrs( e, AttrList( BEGIN_ATTRIB, END_ATTRIB, MODE_ATTR,
-								ORDER_ATTRIB, 0 ));
+								ORDER_ATTRIB, DIST_ATTRIB, MEAN_ATTRIB,
+								SD_ATTRIB, 0 ));
+	DistSpec ds = GetDistSpec( e );
+	if ( ! ds.Empty() ) {
+		return new DSRandInt( GetOrder( e ), ds );
+	}
 	int begin = 0, end = 0;
 	if ( e->HasAttr( BEGIN_ATTRIB ) || e->HasAttr( END_ATTRIB ) ) {
 		begin = GetInt( e, BEGIN_ATTRIB );
@@ -264,6 +356,17 @@ DEFTEST( FromXML1 ) {
 	FAILNE( r.At(0), "2" );
 }
 
+DEFTEST( Batch ) {
+	string xml = "<int_seq begin='1' end='3'/>";
+	XMLPtr xp( xml );
+	DSIntSeq * c = (DSIntSeq *) DSIntSeq::FromXML( xp );
+	Rows rows;
+	c->GetBatch( rows, 4 );
+	FAILNE( rows.size(), 4 );
+	FAILNE( rows[2].At(0), "3" );
+	FAILNE( rows[3].At(0), "1" );
+}
+
 DEFTEST( FromXML2 ) {
 	string xml = "<random_int begin='1' end='10'/>";
 	XMLPtr xp( xml );
@@ -272,6 +375,42 @@ DEFTEST( FromXML2 ) {
 	FAILNE( r.Size(), 1 );
 }
 
+DEFTEST( Poisson ) {
+	string xml = "<rand_int dist='poisson' mean='3'/>";
+	XMLPtr xp( xml );
+	DSRandInt * c = (DSRandInt *) DSRandInt::FromXML( xp );
+	Rows rows;
+	c->GetBatch( rows, 1000 );
+	int sum = 0;
+	for ( unsigned int i = 0; i < rows.size(); i++ ) {
+		FAILNE( ALib::IsInteger( rows[i].At(0) ), true );
+		int n = ALib::ToInteger( rows[i].At(0) );
+		FAILEQ( n < 0, true );
+		sum += n;
+	}
+	FAILEQ( sum < 2700 || sum > 3300, true );
+}
+
+// bad parameters are reported as XML errors
+DEFTEST( BadDist ) {
+	const char * const xml[] = {
+		"<rand_int dist='poisson' mean='-1'/>",
+		"<rand_int dist='normal' mean='3' sd='-2'/>",
+		"<rand_int dist='exponential' mean='0'/>",
+	};
+	for ( unsigned int i = 0; i < 3; i++ ) {
+		XMLPtr xp( xml[i] );
+		bool thrown = false;
+		try {
+			delete DSRandInt::FromXML( xp );
+		}
+		catch( const XMLError & ) {
+			thrown = true;
+		}
+		FAILNE( thrown, true );
+	}
+}
+
 
 #endif
 
@@ -15,7 +15,6 @@
 #include "dmk_strings.h"
 #include "dmk_random.h"
 #include "dmk_modman.h"
-#include <set>
 
 using std::string;
 using std::vector;
@@ -88,10 +87,11 @@ class SeqManyToMany : public ManyToMany {
 };
 
 //----------------------------------------------------------------------------
-// Randomised many to many
+// Randomised many to many. Without dupes, each row is the next pair of
+// left/right row indexes in a permutation of all the possible pairs, so
+// no rows need remembering.
 //----------------------------------------------------------------------------
 
-
 class RandManyToMany : public ManyToMany {
 
 	public:
@@ -101,23 +101,8 @@ class RandManyToMany : public ManyToMany {
 
 	private:
 
-		// simple row comparison functor
-		struct RowCmp {
-			bool operator()( const Row & lhs, const Row & rhs ) {
-				for ( unsigned int i = 0; i < lhs.Size(); i++) {
-					if ( lhs.At(i) < rhs.At(i) ) {
-						return true;
-					}
-					else if ( lhs.At(i) > rhs.At(i) ) {
-						return false;
-					}
-				}
-				return false;
-			}
-		};
-
-		bool AddRow( const Row & r );
-		std::set <Row, RowCmp> mRows;
+		Permutation mPairs;
+		unsigned long long mCount;		// pairs used so far
 };
 
 
@@ -198,6 +183,7 @@ void ManyToMany::GetSides( const ALib::XMLElement * e ) {
 		}
 		ForbidChildren( ce );
 		string gen = ce->AttrValue( GEN_ATTRIB );
+		ModelManager::Instance()->AddGenRef( gen );
 		FieldList fl = FieldList( ce->AttrValue( FIELDS_ATTRIB, "1" ) );
 		if (  ce->Name() == LEFT_TAG ) {
 			if ( mLeft != 0 ) {
@@ -283,47 +269,43 @@ Row SeqManyToMany :: Get() {
 //----------------------------------------------------------------------------
 
 RandManyToMany :: RandManyToMany( const FieldList & order, bool dupes )
-					: ManyToMany( order, dupes ) {
+					: ManyToMany( order, dupes ), mCount( 0 ) {
 }
 
 //----------------------------------------------------------------------------
-// Create random row. If we are not allowing dupes, check it is unique and
-// if not try again until retry limit is reached.
+// Create random row. If we are not allowing dupes, take the next pair from
+// the permutation, failing once every pair has been used.
 //----------------------------------------------------------------------------
 
 Row RandManyToMany :: Get() {
 
 	int lsize = Left()->mGen->Size();
 	int rsize = Right()->mGen->Size();
-	Row r;
-	int tries = 20;
+	int li, ri;
 
-	while(1) {
-		if ( ! AllowDupes() && tries-- < 0 ) {
-			throw Exception( "Duplicate row in many to many" );
+	if ( AllowDupes() ) {
+		li = Rand().Random( 0, lsize );
+		ri = Rand().Random( 0, rsize );
+	}
+	else {
+		unsigned long long pairs = (unsigned long long) lsize * rsize;
+		if ( mCount == 0 ) {
+			unsigned long long key = Rand()();
+			mPairs = Permutation( pairs, (key << 32) | Rand()() );
 		}
-
-		int li = RNG::Random( 0, lsize );
-		int ri = RNG::Random( 0, rsize );
-		r = Left()->mFields.OrderRow( Left()->mGen->RowAt( li ) );
-		r.AppendRow(  Right()->mFields.OrderRow( Right()->mGen->RowAt( ri )) );
-
-		if ( AllowDupes() || AddRow( r ) ) {
-			break;
+		else if ( mCount == pairs ) {
+			throw Exception( "Duplicate row in many to many" );
 		}
+		unsigned long long p = mPairs.At( mCount++ );
+		li = p / rsize;
+		ri = p % rsize;
 	}
 
+	Row r = Left()->mFields.OrderRow( Left()->mGen->RowAt( li ) );
+	r.AppendRow(  Right()->mFields.OrderRow( Right()->mGen->RowAt( ri )) );
 	return r;
 }
 
-//----------------------------------------------------------------------------
-// Try to insert row indexes into set, returning success indicator.
-//----------------------------------------------------------------------------
-
-bool RandManyToMany :: AddRow( const Row & rs ) {
-	return mRows.insert( rs ).second;
-}
-
 //----------------------------------------------------------------------------
 
 } // namespace
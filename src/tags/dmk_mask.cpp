@@ -15,29 +15,34 @@
 #include "dmk_xmlutil.h"
 #include "dmk_strings.h"
 #include "dmk_random.h"
+#include <algorithm>
 
 //----------------------------------------------------------------------------
 
 const char * const MASKED_TAG 		= "mask";
 const char * const MASK_ATTRIB 	= "value";
+const char * const UNIQUE_ATTRIB	= "unique";
 
 using std::string;
 using std::vector;
 
 namespace DMK {
 
-class DSMask : public DataSource {
+class DSMask : public LeafSource {
 
 	public:
 
-		DSMask( const string & mask );
+		DSMask( const string & mask, bool unique = false );
 
-		Row Get();
 		int Size();
 		void Reset() {}		// does nothing
 
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
+	protected:
+
+		void EmitCells( Row & row );
+
 	private:
 
 		std::string GenChars( unsigned int  i ) const;
@@ -58,6 +63,9 @@ class DSMask : public DataSource {
 		};
 
 		std::vector <EncodedMaskChar> mChars;
+
+		bool mIsUnique;
+		UniqueStrings mUnique;
 };
 
 //----------------------------------------------------------------------------
@@ -76,24 +84,45 @@ const char REPEAT_OPT		= '?';	// repeat 0 - N times
 const char REPEAT_DASH		= ':';	// repeat N1 - N2 times
 
 //---------------------------------------------------------------------------
-// Create from mask
+// Create from mask. Unique values are counted through the mask's character
+// sets, one per character, so every character count must be fixed. A set
+// like [a-bab] has repeats, which would give the same string twice, so
+// they are removed from the set.
 //---------------------------------------------------------------------------
 
-DSMask :: DSMask(  const string & mask )
-	: DataSource( FieldList()  ), mMask( mask ) {
+DSMask :: DSMask(  const string & mask, bool unique )
+	: LeafSource( FieldList()  ), mMask( mask ), mIsUnique( unique ) {
 	Encode();
+	if ( mIsUnique ) {
+		vector <string> sets;
+		for ( unsigned int i = 0; i < mChars.size(); i++ ) {
+			const EncodedMaskChar & m = mChars[i];
+			if ( m.mOptional || m.mMin != m.mMax ) {
+				throw Exception( "Unique mask cannot have variable length" );
+			}
+			string cset = m.mCharset;
+			std::sort( cset.begin(), cset.end() );
+			cset.erase( std::unique( cset.begin(), cset.end() ), cset.end() );
+			sets.insert( sets.end(), m.mMin, cset );
+		}
+		mUnique = UniqueStrings( sets );
+	}
 }
 
 //---------------------------------------------------------------------------
-// Get random string generated from mask
+// Add random string generated from mask as a single field
 //---------------------------------------------------------------------------
 
-Row DSMask :: Get() {
+void DSMask :: EmitCells( Row & row ) {
+	if ( mIsUnique ) {
+		row.AppendValue( mUnique.Next( Rand() ) );
+		return;
+	}
 	string rv;
 	for ( unsigned int i = 0; i < mChars.size(); i++ ) {
 		rv += GenChars( i );
 	}
-	return Row( rv );
+	row.AppendValue( rv );
 }
 
 //---------------------------------------------------------------------------
@@ -119,12 +148,12 @@ string DSMask :: GenChars( unsigned int  i ) const {
 		count = m.mMin;
 	}
 	else {							// randomised count
-		count = m.mMin + RNG::Random( 0,  1 + m.mMax - m.mMin );
+		count = m.mMin + Rand().Random( 0,  1 + m.mMax - m.mMin );
 	}
 
 	for ( unsigned int n = 0; n < count; n++ ) {
-		if ( ! m.mOptional  || RNG::Random( 0, 2 ) ) {
-			unsigned int r = RNG::Random( 0, m.mCharset.size() );
+		if ( ! m.mOptional  || Rand().Random( 0, 2 ) ) {
+			unsigned int r = Rand().Random( 0, m.mCharset.size() );
 			rv += m.mCharset[r];	// single random char
 		}
 	}
@@ -254,11 +283,53 @@ DataSource * DSMask :: FromXML( const ALib::XMLElement * e ) {
 
 	ForbidChildren( e );
 	RequireAttrs( e, MASK_ATTRIB );
-	AllowAttrs( e, AttrList( MASK_ATTRIB, 0 ) );
+	AllowAttrs( e, AttrList( MASK_ATTRIB, UNIQUE_ATTRIB, 0 ) );
 
 	string mask = e->AttrValue( MASK_ATTRIB );
-	return new DSMask( mask );
+	bool unique = GetBool( e, UNIQUE_ATTRIB, NO_STR );
+	return new DSMask( mask, unique );
 }
 
 
 } // namespace
+
+//----------------------------------------------------------------------------
+
+#ifdef DMK_TEST
+
+#include "a_myth.h"
+#include <set>
+using namespace ALib;
+using namespace DMK;
+
+DEFSUITE( "Mask" );
+
+// repeated characters in a unique mask's set don't repeat values
+DEFTEST( UniqueRepeats ) {
+	string xml = "<mask value='[a-bab]*2' unique='yes'/>";
+	XMLPtr xp( xml );
+	DSMask * m = (DSMask *) DSMask::FromXML( xp );
+	std::set <string> seen;
+	for ( unsigned int i = 0; i < 4; i++ ) {
+		string s = m->Get().At(0);
+		FAILNE( s.size(), 2 );
+		FAILNE( s.find_first_not_of( "ab" ), string::npos );
+		seen.insert( s );
+	}
+	FAILNE( seen.size(), 4 );
+	bool threw = false;
+	try {
+		m->Get();
+	}
+	catch( const DMK::Exception & ) {
+		threw = true;
+	}
+	FAILNE( threw, true );
+	delete m;
+}
+
+#endif
+
+//----------------------------------------------------------------------------
+
+// end
@@ -26,63 +26,115 @@ namespace DMK {
 
 const char * const MASKED_TAG 		= "masked";
 const char * const MASK_ATTRIB 		= "mask";
+const char * const UNIQUE_ATTRIB	= "unique";
 
 //----------------------------------------------------------------------------
 
-class DSMasked : public DataSource {
+class DSMasked : public LeafSource {
 
 	public:
 
-		DSMasked( const FieldList & order, const string & mask );
+		DSMasked( const FieldList & order, const string & mask,
+					bool unique = false );
 
-		Row Get();
 		int Size();
 		void Reset() {}		// does nothing
 
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
+	protected:
+
+		void EmitCells( Row & row );
+		void EmitCellBatch( Rows & rows, unsigned int n );
+
 	private:
 
+		void MakeValue( string & r );
+
 		string mMask;
+		bool mIsUnique;
+		UniqueStrings mUnique;
 };
 
 //static RegisterDS <DSMasked> regrs1_( MASKED_TAG );
 
-DSMasked :: DSMasked( const FieldList & order, const string & mask )
-	: DataSource( order ), mMask( mask ) {
+// characters each mask character can stand for - others stand for
+// themselves, and backslash escapes the next character
+static const char * MaskChars( char c ) {
+	switch( c ) {
+		case 'A':	return "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+		case 'a':	return "abcdefghijklmnopqrstuvwxyz";
+		case '0':	return "0123456789";
+		case '9':	return "123456789";
+		default:	return 0;
+	}
+}
+
+// unique values are counted through the character sets of the mask
+DSMasked :: DSMasked( const FieldList & order, const string & mask,
+						bool unique )
+	: LeafSource( order ), mMask( mask ), mIsUnique( unique ) {
+	if ( mIsUnique ) {
+		vector <string> sets;
+		for ( unsigned int i = 0; i < mMask.size() ; i++ ) {
+			if ( mMask[i] == '\\' && i < mMask.size() - 1 ) {
+				sets.push_back( string( 1, mMask[++i] ) );
+			}
+			else if ( const char * s = MaskChars( mMask[i] ) ) {
+				sets.push_back( s );
+			}
+			else {
+				sets.push_back( string( 1, mMask[i] ) );
+			}
+		}
+		mUnique = UniqueStrings( sets );
+	}
 }
 
 // helper to produce random character from sequence of chars
-static char RandomChar( const char * s ) {
-	int n = std::strlen( s );
-	return s[ RNG::Random() % n ];
+static char RandomChar( RandomStream & rs, const char * s ) {
+	return s[ rs.Below( std::strlen( s ) ) ];
 }
 
 // All mask decoding done from here
-Row DSMasked :: Get() {
-	string r;
+void DSMasked :: MakeValue( string & r ) {
+	r.clear();
 	for ( unsigned int i = 0; i < mMask.size() ; i++ ) {
 		char c = mMask[i];
 		if ( c == '\\' && i < mMask.size() - 1 ) {
 			r += mMask[++i];
 		}
-		else if ( c == 'A' ) {
-			r += RandomChar( "ABCDEFGHIJKLMNOPQRSTUVWXYZ" );
-		}
-		else if ( c == 'a' ) {
-			r += RandomChar( "abcdefghijklmnopqrstuvwxyz" );
-		}
-		else if ( c == '0' ) {
-			r += RandomChar( "0123456789" );
-		}
-		else if ( c == '9' ) {
-			r += RandomChar( "123456789" );
+		else if ( const char * s = MaskChars( c ) ) {
+			r += RandomChar( Rand(), s );
 		}
 		else {
 			r += c;
 		}
 	}
-	return Order( Row( r ) );
+}
+
+void DSMasked :: EmitCells( Row & row ) {
+	if ( mIsUnique ) {
+		row.AppendValue( mUnique.Next( Rand() ) );
+		return;
+	}
+	string r;
+	MakeValue( r );
+	row.AppendValue( r );
+}
+
+// a block of values reuses one buffer, rather than allocating for each
+void DSMasked :: EmitCellBatch( Rows & rows, unsigned int n ) {
+	if ( mIsUnique ) {
+		LeafSource::EmitCellBatch( rows, n );
+		return;
+	}
+	string r;
+	r.reserve( mMask.size() );
+	for ( unsigned int i = 0; i < n; i++ ) {
+		MakeValue( r );
+		rows[i].AppendValue( r );
+	}
 }
 
 // Masks don't have size
@@ -95,10 +147,11 @@ DataSource * DSMasked :: FromXML( const ALib::XMLElement * e ) {
 
 	ForbidChildren( e );
 	RequireAttrs( e, MASK_ATTRIB );
-	AllowAttrs( e, AttrList( MASK_ATTRIB, ORDER_ATTRIB, 0 ) );
+	AllowAttrs( e, AttrList( MASK_ATTRIB, ORDER_ATTRIB, UNIQUE_ATTRIB, 0 ) );
 
 	string mask = e->AttrValue( MASK_ATTRIB );
-	return new DSMasked( GetOrder( e ), mask );
+	bool unique = GetBool( e, UNIQUE_ATTRIB, NO_STR );
+	return new DSMasked( GetOrder( e ), mask, unique );
 }
 
 //----------------------------------------------------------------------------
@@ -110,6 +163,7 @@ DataSource * DSMasked :: FromXML( const ALib::XMLElement * e ) {
 #ifdef DMK_TEST
 
 #include "a_myth.h"
+#include <set>
 using namespace ALib;
 using namespace DMK;
 
@@ -124,6 +178,43 @@ DEFTEST( FromXML1 ) {
 	FAILNE( r.At(0).size(), 6 );
 }
 
+DEFTEST( Batch ) {
+	string xml = "<masked mask='AAA-99'/>";
+	XMLPtr xp( xml );
+	DSMasked * m = (DSMasked *) DSMasked::FromXML( xp );
+	Rows rows;
+	m->GetBatch( rows, 100 );
+	FAILNE( rows.size(), 100 );
+	for ( unsigned int i = 0; i < rows.size(); i++ ) {
+		FAILNE( rows[i].Size(), 1 );
+		FAILNE( rows[i].At(0).substr( 3, 1 ), "-" );
+	}
+	delete m;
+}
+
+DEFTEST( Unique ) {
+	string xml = "<masked mask='9\\A-a' unique='yes'/>";
+	XMLPtr xp( xml );
+	DSMasked * m = (DSMasked *) DSMasked::FromXML( xp );
+	std::set <string> seen;
+	for ( unsigned int i = 0; i < 9 * 26; i++ ) {
+		string s = m->Get().At(0);
+		FAILNE( s.size(), 4 );
+		FAILNE( s.substr( 1, 2 ), "A-" );
+		seen.insert( s );
+	}
+	FAILNE( seen.size(), 9 * 26 );
+	bool threw = false;
+	try {
+		m->Get();
+	}
+	catch( const DMK::Exception & ) {
+		threw = true;
+	}
+	FAILNE( threw, true );
+	delete m;
+}
+
 #endif
 
 //----------------------------------------------------------------------------
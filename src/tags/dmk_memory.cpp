@@ -65,19 +65,22 @@ class DSMemory : public CompositeDataSource {
 // Reference recalls things
 //----------------------------------------------------------------------------
 
-class DSReference : public DataSource {
+class DSReference : public LeafSource {
 
 	public:
 
 		DSReference( const FieldList & order, const string & name,
 							bool rand );
 
-		Row Get();
 		int Size();
 		void Reset() {} 	// does NOT reset thing referred to
 
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
+	protected:
+
+		void EmitCells( Row & row );
+
 	private:
 
 		void GetMem();
@@ -125,7 +128,7 @@ Row DSMemory :: Get() {
 		Row tmp;
 		for ( unsigned int i = 0; i < r.Size(); i++ ) {
 			if ( mFields.Contains( i ) ) {
-				tmp.AppendValue( r.At(i) );
+				tmp.AppendField( r, i );
 			}
 		}
 		r = tmp;
@@ -220,7 +223,7 @@ DataSource * DSMemory :: FromXML( const ALib::XMLElement * e ) {
 
 DSReference :: DSReference( const FieldList & order,
 								const string & name, bool random )
-		: DataSource( order ), mName( name ), mPos( 0 ),
+		: LeafSource( order ), mName( name ), mPos( 0 ),
 					mMem( 0 ), mGen(0), mRand( random ) {
 }
 
@@ -242,32 +245,31 @@ void DSReference :: GetMem() {
 }
 
 //----------------------------------------------------------------------------
-// get from memory or generator referred to by name
+// add row from memory or generator referred to by name - the row is shared
+// rather than copied.
 // note mPos is recalculated even if we are in random mode when
 // it will get overwritten first thing next call - no big deal
 //----------------------------------------------------------------------------
 
-Row DSReference :: Get() {
+void DSReference :: EmitCells( Row & row ) {
 
 	GetMem();
 
 	if ( mRand ) {
-		mPos = RNG::Random() % Size();
+		mPos = Rand().Below( Size() );
 	}
 
 	if ( mMem ) {
-		Row r = mMem->mRows.at( mPos );
+		row.AppendRef( mMem->mRows.at( mPos ) );
 		mPos = (mPos + 1) % mMem->mRows.size();
-		return Order( r );
 	}
 	else {
 		if ( mGen->Size() == 0 ) {
 			throw Exception( "Generator " + ALib::SQuote( mName )
 								+ " has no data" );
 		}
-		Row r = mGen->RowAt( mPos );
+		row.AppendRef( mGen->RowAt( mPos ) );
 		mPos = (mPos + 1) % mGen->Size();
-		return Order( r );
 	}
 }
 
@@ -292,6 +294,7 @@ DataSource * DSReference :: FromXML( const ALib::XMLElement * e ) {
 
 	string name = e->AttrValue( NAME_ATTRIB );
 	bool rand = GetRandom( e );
+	ModelManager::Instance()->AddGenRef( name );	// may be memory instead
 	return new DSReference( GetOrder( e ), name, rand );
 }
 
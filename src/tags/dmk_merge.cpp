@@ -33,12 +33,14 @@ class DSMerge : public CompositeDataSource {
 		DSMerge( const FieldList & order, const std::string & sep  );
 
 		Row Get();
+		void Emit( Row & row );
 
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
 
 	private:
 
+		std::string Merge();
 		std::string mSep;
 
 };
@@ -58,10 +60,10 @@ DSMerge :: DSMerge( const FieldList & order, const string & sep  )
 }
 
 //----------------------------------------------------------------------------
-// get a row and merge all fields
+// get a row and merge all fields into a single value
 //----------------------------------------------------------------------------
 
-Row DSMerge :: Get() {
+string DSMerge :: Merge() {
 	Row r = CompositeDataSource::Get();
 	string s;
 	for ( unsigned int i = 0; i < r.Size() ; i++ ) {
@@ -72,11 +74,24 @@ Row DSMerge :: Get() {
 			s += r.At( i );
 		}
 	}
+	return s;
+}
+
+Row DSMerge :: Get() {
 	Row rv;		// remember Row(s) will treat s as csv!
-	rv.AppendValue( s );
+	rv.AppendValue( Merge() );
 	return Order( rv );
 }
 
+void DSMerge :: Emit( Row & row ) {
+	if ( Ordered() ) {
+		row.AppendRow( Get() );
+	}
+	else {
+		row.AppendValue( Merge() );
+	}
+}
+
 //----------------------------------------------------------------------------
 // create from xml
 //----------------------------------------------------------------------------
@@ -32,18 +32,21 @@ class DSPick : public CompositeDataSource {
 	public:
 
 		DSPick( const FieldList & order, bool rand,
-					const vector <int> & dist  );
+					const vector <double> & dist  );
 
 		Row Get();
+		void Emit( Row & row );
 		int Size();
 
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
 	private:
 
+		DataSource * Next();
+
 		bool mRand;
 		int mPos;
-		vector <int> mDistrib;
+		AliasTable mDistrib;
 };
 
 //----------------------------------------------------------------------------
@@ -55,41 +58,44 @@ static RegisterDS <DSPick> regrs1_( PICK_TAG );
 
 //----------------------------------------------------------------------------
 // Constructor specifies whther to randomise and what distribution (expressed
-// as percents in the dist array) to use.
+// as relative weights in the dist array) to use.
 //----------------------------------------------------------------------------
 
 DSPick :: DSPick( const FieldList & order, bool rand,
-						const vector <int> & dist  )
-	: CompositeDataSource( order ), mRand( rand ), mPos(0), mDistrib( dist )  {
+						const vector <double> & dist  )
+	: CompositeDataSource( order ), mRand( rand ), mPos(0)  {
+	if ( dist.size() ) {
+		mDistrib.Build( dist );
+	}
 }
 
 //----------------------------------------------------------------------------
-// pick randomly or alternately
+// pick randomly or alternately - the picked source provides the values
 //----------------------------------------------------------------------------
 
 Row DSPick  :: Get() {
+	return Next()->Get();
+}
+
+void DSPick  :: Emit( Row & row ) {
+	Next()->Emit( row );
+}
+
+DataSource * DSPick  :: Next() {
 	if ( mRand ) {
 		unsigned int i;
-		if ( mDistrib.size() == 0 ) {
-			i = RNG::Random() % SourceCount();
+		if ( mDistrib.Size() == 0 ) {
+			i = Rand().Below( SourceCount() );
 		}
 		else {
-			int rp = RNG::Random( 0, 100 );
-			int t = 0;
-			for ( i = 0; i < mDistrib.size(); i++ ) {
-				t += mDistrib.at(i);
-				if ( rp <= t ) {
-					break;
-				}
-			}
+			i = mDistrib.Pick( Rand() );
 		}
-		Row r = SourceAt( i )->Get();
-		return r;
+		return SourceAt( i );
 	}
 	else {
-		Row r = SourceAt( mPos++ )->Get();
+		DataSource * ds = SourceAt( mPos++ );
 		mPos %= SourceCount();
-		return r;
+		return ds;
 	}
 }
 
@@ -114,21 +120,21 @@ DataSource * DSPick :: FromXML( const ALib::XMLElement * e ) {
 	if ( d.Size() && ! rand ) {
 		throw XMLError( "Cannot have distribution", e );
 	}
-	vector <int> dv;
-	int total = 0;
+	vector <double> dv;
+	double total = 0;
 	for ( unsigned int i = 0; i < d.Size(); i++ ) {
-		if ( ! ALib::IsInteger( d.At(i) ) ) {
-			throw XMLError( d.At(i) + " not integer", e );
+		if ( ! ALib::IsNumber( d.At(i) ) ) {
+			throw XMLError( d.At(i) + " not a number", e );
 		}
-		int n = ALib::ToInteger( d.At(i) );
-		if ( n <= 0 )  {
-			throw XMLError( "Distribution value cannot be zero or less", e );
+		double n = ALib::ToReal( d.At(i) );
+		if ( n < 0 )  {
+			throw XMLError( "Distribution value cannot be negative", e );
 		}
 		dv.push_back( n );
 		total += n;
 	}
-	if ( dv.size() != 0 && total != 100 ) {
-		throw XMLError( "Values must total 100%", e );
+	if ( dv.size() != 0 && total <= 0 ) {
+		throw XMLError( "Distribution values cannot all be zero", e );
 	}
 
 	std::auto_ptr <DSPick> pk( new DSPick( GetOrder( e ), rand, dv ) );
@@ -183,6 +189,21 @@ DEFTEST( TestRandom ) {
 	Row r = c->Get();
 }
 
+DEFTEST( Weighted ) {
+	string xml =
+		"<pick distribute='0,2.5,0'>\n"
+			"<row values='foo' />\n"
+			"<row values='bar' />\n"
+			"<row values='baz' />\n"
+		"</pick>\n";
+
+	XMLPtr xp( xml );
+	DSPick * c = (DSPick *) DSPick::FromXML( xp );
+	for ( unsigned int i = 0; i < 100; i++ ) {
+		FAILNE( c->Get().At(0), "bar" );
+	}
+}
+
 #endif
 
 //----------------------------------------------------------------------------
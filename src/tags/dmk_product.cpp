@@ -1,7 +1,7 @@
 //---------------------------------------------------------------------------
 // dmk_product.cpp
 //
-// Produce cartesian product of two sources
+// Produce cartesian product of two or more sources
 //
 // Copyright (C) 2009 Neil Butterworth
 //---------------------------------------------------------------------------
@@ -13,6 +13,7 @@
 #include "dmk_tagdict.h"
 #include "dmk_xmlutil.h"
 #include "dmk_strings.h"
+#include <climits>
 
 using std::string;
 using std::vector;
@@ -23,18 +24,35 @@ namespace DMK {
 
 const char * const PRODUCT_TAG 		= "product";
 
+//----------------------------------------------------------------------------
+// The product is not built - only the rows of the children are kept, and
+// row i of the product is made from them when it is needed by treating i
+// as a mixed radix number whose digits index the children's rows, the
+// last child varying fastest.
 //----------------------------------------------------------------------------
 
-class DSProduct : public Intermediate {
+class DSProduct : public CompositeDataSource {
 
 	public:
 
 		DSProduct( const FieldList & order, bool rand );
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
-		void Populate();
+		Row Get();
+		void Emit( Row & row );
+		int Size();
+		void Discard();
+
+	private:
 
+		void Populate();
+		unsigned long long NextIndex();
+		const Row & Part( unsigned int k, unsigned long long i ) const;
 
+		std::vector <Rows> mInputs;
+		std::vector <unsigned long long> mStrides;	// product rows per child row
+		unsigned long long mSize, mPos;
+		bool mRand;
 };
 
 //----------------------------------------------------------------------------
@@ -48,54 +66,124 @@ static RegisterDS <DSProduct> regrs1_( PRODUCT_TAG );
 //----------------------------------------------------------------------------
 
 DSProduct :: DSProduct( const FieldList & order, bool rand  )
-	: Intermediate( order, rand )  {
+	: CompositeDataSource( order ), mSize( 0 ), mPos( 0 ), mRand( rand ) {
 }
 
-
 //----------------------------------------------------------------------------
-// build the product - we know there are two child sources
+// Get the rows of all the children, which are then no longer needed
 //----------------------------------------------------------------------------
 
 void DSProduct :: Populate() {
 
-	// get sizes & force creation of child data
-	int sz0 = SourceAt(0)->Size();
-	int sz1 = SourceAt(1)->Size();
+	if ( mSize ) {
+		return;
+	}
 
-	if ( sz0 <= 0 || sz1 <= 0 ) {
-		throw Exception( "no size info" );
+	vector <int> sizes;
+	for ( unsigned int k = 0; k < SourceCount(); k++ ) {
+		int sz = SourceAt( k )->Size();
+		if ( sz <= 0 ) {
+			throw Exception( "no size info" );
+		}
+		sizes.push_back( sz );
 	}
 
-	// get all rows from source #1
-	Rows tmp1;
-	for (  int i = 0; i < sz1 ; i++ ) {
-		tmp1.push_back( SourceAt(1)->Get() );
+	mStrides.assign( SourceCount(), 1 );
+	unsigned long long n = 1;
+	for ( unsigned int k = SourceCount(); k-- > 0; ) {
+		mStrides[k] = n;
+		if ( n > ~0ULL / sizes[k] ) {
+			throw Exception( "product has too many rows" );
+		}
+		n *= sizes[k];
 	}
 
-	// build product of sources #1 and #2
-	for ( int i = 0; i < sz0 ; i++ ) {
-		Row r = SourceAt(0)->Get();
-		for ( int i = 0; i < sz1 ; i++ ) {
-			Row r2(r);
-			r2.AppendRow( tmp1[i] );
-			AddRow( r2 );
+	mInputs.assign( SourceCount(), Rows() );
+	for ( unsigned int k = 0; k < SourceCount(); k++ ) {
+		for ( int i = 0; i < sizes[k]; i++ ) {
+			mInputs[k].push_back( SourceAt( k )->Get() );
+			mInputs[k].back().Flatten();
 		}
+		SourceAt( k )->Discard();
+	}
+	mSize = n;
+	mPos = 0;
+}
+
+//----------------------------------------------------------------------------
+// Index of the next row, in order or at random
+//----------------------------------------------------------------------------
+
+unsigned long long DSProduct :: NextIndex() {
+	Populate();
+	if ( mRand ) {
+		return Rand().Below64( mSize );
+	}
+	unsigned long long i = mPos++;
+	if ( mPos == mSize ) {
+		mPos = 0;
 	}
+	return i;
+}
 
-	// no longer need the child data
-	SourceAt(0)->Discard();
-	SourceAt(1)->Discard();
+// the row of child k used by product row i
+const Row & DSProduct :: Part( unsigned int k, unsigned long long i ) const {
+	return mInputs[k][ (i / mStrides[k]) % mInputs[k].size() ];
 }
 
 //----------------------------------------------------------------------------
-// create from xml - need to check that there are only two child sources
+// Rows are made by appending the children's rows, which are shared rather
+// than copied unless the result must be re-ordered.
+//----------------------------------------------------------------------------
+
+Row DSProduct :: Get() {
+	unsigned long long i = NextIndex();
+	Row r;
+	for ( unsigned int k = 0; k < mInputs.size(); k++ ) {
+		r.AppendRow( Part( k, i ) );
+	}
+	return Order( r );
+}
+
+void DSProduct :: Emit( Row & row ) {
+	if ( Ordered() ) {
+		row.AppendRow( Get() );
+		return;
+	}
+	unsigned long long i = NextIndex();
+	for ( unsigned int k = 0; k < mInputs.size(); k++ ) {
+		row.AppendRef( Part( k, i ) );
+	}
+}
+
+//----------------------------------------------------------------------------
+// Size is the product of the children's sizes
+//----------------------------------------------------------------------------
+
+int DSProduct :: Size() {
+	Populate();
+	if ( mSize > (unsigned long long) INT_MAX ) {
+		throw Exception( "product has too many rows to count" );
+	}
+	return (int) mSize;
+}
+
+void DSProduct :: Discard() {
+	mInputs.clear();
+	mStrides.clear();
+	mSize = 0;
+	CompositeDataSource::Discard();
+}
+
+//----------------------------------------------------------------------------
+// create from xml - need at least two child sources
 //----------------------------------------------------------------------------
 
 DataSource * DSProduct :: FromXML( const ALib::XMLElement * e ) {
 	RequireChildren( e );
 	AllowAttrs( e, AttrList( ORDER_ATTRIB, RANDOM_ATTRIB, 0 ) );
-	if ( e->ChildCount() != 2 ) {
-		XMLError( "require exactly two child sources", e );
+	if ( e->ChildCount() < 2 ) {
+		throw XMLError( "require at least two child sources", e );
 	}
 	bool rand = GetRandom( e, NO_STR );
 	std::auto_ptr <DSProduct> c( new DSProduct( GetOrder( e ), rand ));
@@ -112,6 +200,7 @@ DataSource * DSProduct :: FromXML( const ALib::XMLElement * e ) {
 #ifdef DMK_TEST
 
 #include "a_myth.h"
+#include <algorithm>
 using namespace ALib;
 using namespace DMK;
 
@@ -140,6 +229,50 @@ DEFTEST( Simple ) {
 	FAILNE( r.At(1), "a" );
 }
 
+const char * const XML2 =
+	"<product>\n"
+		"<rows values='1,2' random='no'/>\n"
+		"<int_seq begin='1' end='3'/>\n"
+		"<rows values='a,b' random='no'/>\n"
+	"</product>\n";
+
+// more than two children, with the last varying fastest
+DEFTEST( Three ) {
+	XMLPtr xml( XML2 );
+	DSProduct * p = (DSProduct *) DSProduct::FromXML( xml );
+	FAILNE( p->Size(), 12 );
+	for ( int i = 0; i < 24; i++ ) {
+		Row r;
+		p->Emit( r );
+		FAILNE( r.Size(), 3 );
+		FAILNE( r.At( 0 ), ALib::Str( i % 12 / 6 + 1 ) );
+		FAILNE( r.At( 1 ), ALib::Str( i % 6 / 2 + 1 ) );
+		FAILNE( r.At( 2 ), i % 2 ? "b" : "a" );
+	}
+	delete p;
+}
+
+const char * const XML3 =
+	"<product random='yes' order='2,1'>\n"
+		"<int_seq begin='1' end='10'/>\n"
+		"<int_seq begin='1' end='10'/>\n"
+	"</product>\n";
+
+// random rows are all in the product, and cover it
+DEFTEST( Random ) {
+	XMLPtr xml( XML3 );
+	DSProduct * p = (DSProduct *) DSProduct::FromXML( xml );
+	std::vector <int> seen( 100 );
+	for ( int i = 0; i < 2000; i++ ) {
+		Row r = p->Get();
+		int a = ALib::ToInteger( r.At( 1 ) ), b = ALib::ToInteger( r.At( 0 ) );
+		FAILEQ( a < 1 || a > 10 || b < 1 || b > 10, true );
+		seen[ (a - 1) * 10 + b - 1 ]++;
+	}
+	FAILNE( std::count( seen.begin(), seen.end(), 0 ), 0 );
+	delete p;
+}
+
 
 #endif
 
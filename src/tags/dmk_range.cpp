@@ -87,14 +87,14 @@ void DSRange :: Reset() {
 Row DSRange :: Get() {
 
 	Row r;
-	int n = RNG::Random( mMin, mMax + 1 );
+	int n = Rand().Random( mMin, mMax + 1 );
 
 	if ( mCont && mLast.Size() ) {
-		r.AppendRow( mLast );
+		r.AppendRef( mLast );
 		mLast = Row();
 	}
 	else {
-		r.AppendRow( CompositeDataSource::Get() );
+		r.AppendRef( CompositeDataSource::Get() );
 	}
 
 	for ( int i = 1; i < n; i++ ) {
@@ -102,7 +102,7 @@ Row DSRange :: Get() {
 		Row r2 = CompositeDataSource::Get();
 
 		if ( mFill || i == n - 1 ) {
-			r.AppendRow( r2 );
+			r.AppendRef( r2 );
 		}
 
 		if ( mCont && i == n - 1 ) {
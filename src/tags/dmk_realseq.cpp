@@ -17,8 +17,6 @@
 #include "dmk_types.h"
 
 #include <cmath>
-#include <sstream>
-#include <iomanip>
 #include <float.h>
 
 using std::string;
@@ -37,30 +35,36 @@ const char * const PREC_ATTR 		= "places";
 // Sequential reals
 //----------------------------------------------------------------------------
 
-class DSRealSeq : public DataSource, public SequenceType {
+class DSRealSeq : public LeafSource, public SequenceType {
 
 	public:
 
 		DSRealSeq( const FieldList & order,	double  begin,
 					double end,  double inc, int prec);
 
-		Row Get();
 		int Size();
 		void Reset();
+		void EmitAt( Row & row, unsigned long long i );
+		bool DistinctText() const;
 
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
+	protected:
+
+		void EmitCells( Row & row );
+
 	private:
 
-		double mBegin, mNow, mEnd, mInc;
+		double mBegin, mEnd, mInc;
 		int mPrec;
+		unsigned int mStep;			// index of next value in cycle
 };
 
 //----------------------------------------------------------------------------
 // Non-sequential random real numbers
 //----------------------------------------------------------------------------
 
-class DSRandReal : public DataSource {
+class DSRandReal : public LeafSource {
 
 	public:
 
@@ -68,19 +72,26 @@ class DSRandReal : public DataSource {
 								double end, int prec );
 		DSRandReal( const FieldList & order, double begin,
 								double end, double mode, int prec );
+		DSRandReal( const FieldList & order, const DistSpec & ds,
+								int prec );
 
 		~DSRandReal();
 
-		Row Get();
 		int Size();
         void Reset() {} 	// does nothing
 
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
+	protected:
+
+		void EmitCells( Row & row );
+		void EmitCellBatch( Rows & rows, unsigned int n );
+
 	private:
 
 		Distribution * mDist;
 		int mPrec;
+		std::vector <double> mValues;
 };
 
 //----------------------------------------------------------------------------
@@ -90,58 +101,39 @@ class DSRandReal : public DataSource {
 static RegisterDS <DSRealSeq> regrs1_( REALSEQ_TAG );
 static RegisterDS <DSRandReal> regrs2_( RANDREAL_TAG );
 
-//----------------------------------------------------------------------------
-// Helper to print number with prec digiyts after decimal point
-//----------------------------------------------------------------------------
-
-static string WriteReal( double d, int prec ) {
-	std::ostringstream os;
-	if ( prec != 0 ) {
-		os << std::showpoint << std::fixed << std::setprecision( prec ) << d;
-	}
-	else {
-		os << std::noshowpoint << std::fixed << std::setprecision( 0 ) << d;
-	}
-	return os.str();
-}
-
 //----------------------------------------------------------------------------
 // Non-random real sequence
 //----------------------------------------------------------------------------
 
 DSRealSeq :: DSRealSeq( const FieldList & order,
 						double begin, double end, double inc, int prec )
-	: DataSource( order ),
-		mBegin( begin ), mNow( begin ), mEnd( end), mInc( inc ), mPrec( prec )  {
+	: LeafSource( order ),
+		mBegin( begin ), mEnd( end), mInc( inc ), mPrec( prec ), mStep( 0 ) {
 }
 
 //----------------------------------------------------------------------------
-// Return current value, increment value. Needs to take into account
-// whether we are going up or down.
+// Return current value and step on, wrapping at the end of the cycle.
+// Values are worked out from their index rather than summed, so rounding
+// errors don't build up and the values are the same as EmitAt() gives.
+// The value is formatted with the required decimal places only when output.
 //----------------------------------------------------------------------------
 
-Row DSRealSeq  :: Get() {
+void DSRealSeq  :: EmitCells( Row & row ) {
+	EmitAt( row, mStep );
+	mStep = ( mStep + 1 ) % Size();
+}
 
-	string s = WriteReal( mNow, mPrec );
+//----------------------------------------------------------------------------
+// Value i of the cycle is worked out directly. A value that should be zero
+// may come out a tiny bit negative, and would then be shown as -0.00
+//----------------------------------------------------------------------------
 
-	if ( mInc > 0 ) {
-		if ( mNow + mInc > mEnd ) {
-			mNow = mBegin;
-		}
-		else {
-			mNow += mInc;
-		}
+void DSRealSeq :: EmitAt( Row & row, unsigned long long i ) {
+	double v = mBegin + double( i % Size() ) * mInc;
+	if ( std::fabs( v ) < std::fabs( mInc ) * 1e-9 ) {
+		v = 0.0;
 	}
-	else {
-		if ( mNow + mInc < mEnd ) {
-			mNow = mBegin;
-		}
-		else {
-			mNow += mInc;
-		}
-	}
-
-	return Order( Row( s ) );
+	row.AppendReal( v, mPrec );
 }
 
 //----------------------------------------------------------------------------
@@ -149,15 +141,34 @@ Row DSRealSeq  :: Get() {
 //----------------------------------------------------------------------------
 
 void DSRealSeq :: Reset() {
-	mNow = mBegin;
+	mStep = 0;
 }
 
 //----------------------------------------------------------------------------
-// Size is difference between begin & end - always at least 1
+// Size is difference between begin & end - always at least 1. The quotient
+// is given a little slack, as 0.3 / 0.1 comes out just under 3 and would
+// otherwise lose the end value.
 //----------------------------------------------------------------------------
 
 int DSRealSeq :: Size() {
-	return 1 + std::fabs( mBegin - mEnd ) / std::fabs( mInc );
+	return 1 + int( std::fabs( mBegin - mEnd ) / std::fabs( mInc ) + 1e-9 );
+}
+
+//----------------------------------------------------------------------------
+// Values closer than the decimal places shown can format the same. They
+// can't if the increment is at least two places' worth, or a whole number
+// of places with a begin value that is too.
+//----------------------------------------------------------------------------
+
+bool DSRealSeq :: DistinctText() const {
+	double scale = std::pow( 10.0, mPrec );
+	double steps = std::fabs( mInc ) * scale, start = mBegin * scale;
+	if ( steps >= 2 ) {
+		return true;
+	}
+	return steps >= 1
+		&& std::fabs( steps - std::floor( steps + 0.5 ) ) < 1e-6
+		&& std::fabs( start - std::floor( start + 0.5 ) ) < 1e-6;
 }
 
 //----------------------------------------------------------------------------
@@ -188,26 +199,32 @@ DataSource * DSRealSeq :: FromXML( const ALib::XMLElement * e ) {
 }
 
 //----------------------------------------------------------------------------
-// Random reals. may use uniform or triangular distribution.
+// Random reals. may use uniform or triangular distribution, or one named
+// by a dist attribute.
 //----------------------------------------------------------------------------
 
 DSRandReal :: DSRandReal( const FieldList & order, double begin,
 									double end, int prec )
-	: DataSource( order ), mDist( 0 ), mPrec( prec ) {
+	: LeafSource( order ), mDist( 0 ), mPrec( prec ) {
 
 	if ( begin == end ) {
-		mDist = new UniformDist( 0, DBL_MAX);
+		mDist = new UniformDist( Rand(), 0, DBL_MAX);
 	}
 	else {
-		mDist = new UniformDist( begin, end );
+		mDist = new UniformDist( Rand(), begin, end );
 	}
 }
 
 DSRandReal :: DSRandReal( const FieldList & order,
 								double begin,
 								double end, double mode, int prec )
-	: DataSource( order ),
-		mDist( new TriangleDist( begin, mode, end )  ), mPrec( prec ) {
+	: LeafSource( order ),
+		mDist( new TriangleDist( Rand(), begin, mode, end )  ), mPrec( prec ) {
+}
+
+DSRandReal :: DSRandReal( const FieldList & order, const DistSpec & ds,
+								int prec )
+	: LeafSource( order ), mDist( ds.Make( Rand() ) ), mPrec( prec ) {
 }
 
 //----------------------------------------------------------------------------
@@ -222,8 +239,20 @@ DSRandReal :: ~DSRandReal() {
 // Get next value from distribution
 //----------------------------------------------------------------------------
 
-Row DSRandReal :: Get() {
-	return Order( Row( WriteReal( mDist->NextReal(), mPrec ) ));
+void DSRandReal :: EmitCells( Row & row ) {
+	row.AppendReal( mDist->NextReal(), mPrec );
+}
+
+//----------------------------------------------------------------------------
+// Block of values made by the distribution in one go
+//----------------------------------------------------------------------------
+
+void DSRandReal :: EmitCellBatch( Rows & rows, unsigned int n ) {
+	mValues.resize( n );
+	mDist->FillReal( &mValues[0], n );
+	for ( unsigned int i = 0; i < n; i++ ) {
+		rows[i].AppendReal( mValues[i], mPrec );
+	}
 }
 
 //----------------------------------------------------------------------------
@@ -241,12 +270,17 @@ int DSRandReal :: Size() {
 DataSource * DSRandReal :: FromXML( const ALib::XMLElement * e ) {
 	ForbidChildren( e );
 	AllowAttrs( e, AttrList( BEGIN_ATTRIB, END_ATTRIB, MODE_ATTR,
-								ORDER_ATTRIB, PREC_ATTR, 0 ));
+								ORDER_ATTRIB, PREC_ATTR, DIST_ATTRIB,
+								MEAN_ATTRIB, SD_ATTRIB, 0 ));
 	double begin = 0, end = 0;
 	int prec = GetInt( e, PREC_ATTR, "2" );
 	if ( prec < 0 || prec > 10 ) {
 		XMLERR( e, "Invalid number of decimal places: " << prec );
 	}
+	DistSpec ds = GetDistSpec( e );
+	if ( ! ds.Empty() ) {
+		return new DSRandReal( GetOrder( e ), ds, prec );
+	}
 	if ( e->HasAttr( BEGIN_ATTRIB ) || e->HasAttr( END_ATTRIB ) ) {
 		begin = GetReal( e, BEGIN_ATTRIB );
 		end = GetReal( e, END_ATTRIB );
@@ -293,6 +327,39 @@ DEFTEST( FromXML1 ) {
 	FAILNE( r.At(0), "2.0" );
 }
 
+DEFTEST( Ends ) {
+	const double ends[] = { 0.3, 0.7, 1.0 };
+	const char * const shown[] = { "0.30", "0.70", "1.00" };
+	for ( unsigned int i = 0; i < 3; i++ ) {
+		double end = ends[i];
+		DSRealSeq up( FieldList(), 0.0, end, 0.1, 2 );
+		DSRealSeq down( FieldList(), end, 0.0, -0.1, 2 );
+		int n = up.Size();
+		FAILNE( n, int( end * 10 + 0.5 ) + 1 );
+		FAILNE( down.Size(), n );
+		Row r;
+		for ( int j = 0; j < n; j++ ) {
+			r = up.Get();
+		}
+		FAILNE( r.At(0), shown[i] );
+		FAILNE( up.Get().At(0), "0.00" );
+		for ( int j = 0; j < n; j++ ) {
+			r = down.Get();
+		}
+		FAILNE( r.At(0), "0.00" );
+		FAILNE( down.Get().At(0), shown[i] );
+	}
+}
+
+// values shown to fewer places than the increment needs may repeat
+DEFTEST( DistinctText ) {
+	FAILNE( DSRealSeq( FieldList(), 0.0, 1.0, 0.1, 2 ).DistinctText(), true );
+	FAILNE( DSRealSeq( FieldList(), 0.05, 1.0, 0.01, 2 ).DistinctText(), true );
+	FAILNE( DSRealSeq( FieldList(), 0.005, 1.0, 0.01, 2 ).DistinctText(), false );
+	FAILNE( DSRealSeq( FieldList(), 0.0, 0.011, 0.001, 2 ).DistinctText(), false );
+	FAILNE( DSRealSeq( FieldList(), 0.005, 1.0, 0.025, 2 ).DistinctText(), true );
+}
+
 DEFTEST( FromXML2 ) {
 	string xml = "<rand_real begin='1' end='10'/>";
 	XMLPtr xp( xml );
@@ -25,23 +25,25 @@ namespace DMK {
 const char * const ROW_TAG 		= "row";
 const char * const VALUES_ATTRIB 	= "values";
 const char * const ROWS_TAG 		= "rows";
-const char * const FREQ_ATTR 		= "freq";
 
 //----------------------------------------------------------------------------
 // Single row as comma separated list. Each field  is a field in the output
 //----------------------------------------------------------------------------
 
-class DSRow : public DataSource {
+class DSRow : public LeafSource {
 
 	public:
 
 		DSRow( const FieldList & order  );
 
-		Row Get();
 		int Size();
 		void Reset() {}		// do nothing
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
+	protected:
+
+		void EmitCells( Row & row );
+
 	private:
 
 		Row mRow;
@@ -52,26 +54,29 @@ class DSRow : public DataSource {
 // Alternatively, multiple rows specified as cdata.
 //----------------------------------------------------------------------------
 
-class DSRows : public DataSource {
+class DSRows : public LeafSource {
 
 	public:
 
 		DSRows( const FieldList & order );
 
-		Row Get();
 		int Size();
 		void Reset();
 
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
+	protected:
+
+		void EmitCells( Row & row );
+
 	private:
 
-		Row FreqGet();
+		const Row & FreqNext();
 
 		bool mRandom;
 		int mPos;
 		Rows mRows;
-		std::vector <int> mFreqs;
+		AliasTable mFreqs;
 };
 
 //----------------------------------------------------------------------------
@@ -86,15 +91,15 @@ static RegisterDS <DSRows> regrs2_( ROWS_TAG );
 //----------------------------------------------------------------------------
 
 DSRow :: DSRow( const FieldList & order )
-	: DataSource( order ) {
+	: LeafSource( order ) {
 }
 
 //----------------------------------------------------------------------------
-// Get single row
+// Add the single row's values to the caller's row
 //----------------------------------------------------------------------------
 
-Row DSRow :: Get() {
-	return Order( mRow );
+void DSRow :: EmitCells( Row & row ) {
+	row.AppendRow( mRow );
 }
 
 //----------------------------------------------------------------------------
@@ -134,44 +139,38 @@ DataSource * DSRow :: FromXML( const ALib::XMLElement * e ) {
 //----------------------------------------------------------------------------
 
 DSRows :: DSRows( const FieldList & order )
-		: DataSource( order ), mRandom( false ), mPos( 0 )  {
+		: LeafSource( order ), mRandom( false ), mPos( 0 )  {
 }
 
 //----------------------------------------------------------------------------
-// Get row. If frequency field is specified, use that.
+// Add row's values. If frequency field is specified, use that.
 //----------------------------------------------------------------------------
 
-Row DSRows :: Get() {
+void DSRows :: EmitCells( Row & row ) {
 
-	if ( mFreqs.size()  && mRandom ) {
-		return FreqGet();
+	if ( mFreqs.Size()  && mRandom ) {
+		row.AppendRow( FreqNext() );
+		return;
 	}
 
 	int i;
 	if ( mRandom ) {
-		i = RNG::Random() % mRows.size();
+		i = Rand().Below( mRows.size() );
 	}
 	else {
 		i = mPos++;
 		mPos %= mRows.size();
 	}
-	return Order( mRows[i] );
+	row.AppendRow( mRows[i] );
 }
 
 //----------------------------------------------------------------------------
 // Frequency was specified. Use that field to select row. This is only used
-// if we are in nrandom mode.
+// if we are in random mode.
 //----------------------------------------------------------------------------
 
-Row DSRows :: FreqGet() {
-	int n = RNG::Random( 0, 100 ), sum = 0;
-	for ( unsigned int i = 0; i < mFreqs.size(); i++ ) {
-		sum += mFreqs[i];
-		if ( n < sum ) {
-			return Order( mRows[i] );
-		}
-	}
-	throw Exception( "freq problem" );
+const Row & DSRows :: FreqNext() {
+	return mRows[ mFreqs.Pick( Rand() ) ];
 }
 
 //----------------------------------------------------------------------------
@@ -199,10 +198,10 @@ DataSource * DSRows :: FromXML( const ALib::XMLElement * e ) {
 
 	AllowChildTags( e, "" );
 	AllowAttrs( e, AttrList( ORDER_ATTRIB, VALUES_ATTRIB,
-								RANDOM_ATTRIB, FREQ_ATTR, 0 ) );
+								RANDOM_ATTRIB, FREQ_ATTRIB, 0 ) );
 
 	ALib::CommaList vl = e->AttrValue( VALUES_ATTRIB, "" );
-	int freq = GetInt( e, FREQ_ATTR, "0" ) - 1;
+	int freq = GetInt( e, FREQ_ATTRIB, "0" ) - 1;
 	std::auto_ptr <DSRows> rp( new DSRows( GetOrder( e ) ) );
 	rp->mRandom = GetRandom( e );;
 
@@ -225,25 +224,28 @@ DataSource * DSRows :: FromXML( const ALib::XMLElement * e ) {
 	}
 
 	// if frequency column number specified, save frequencies and
-	// remove frequency column from row
+	// remove frequency column from row - frequencies are weights, so
+	// needn't be percentages
 	if ( freq >= 0 ) {
-		int sum = 0;
+		vector <double> weights;
+		double sum = 0;
 		for ( unsigned int i = 0; i < rp->mRows.size();i++ ) {
 			Row r = rp->mRows.at( i );
-			if ( r.Size() <= freq || ! ALib::IsInteger( r.At(freq) ) ) {
+			if ( r.Size() <= freq || ! ALib::IsNumber( r.At(freq) ) ) {
 				XMLERR( e, "No valid frequency value in row " << r );
 			}
-			int fv = ALib::ToInteger( r.At( freq ) );
-			if ( fv < 0 || fv > 100 ) {
-				XMLERR( e, "Frequency value must be in range 0 to 100" << r );
+			double fv = ALib::ToReal( r.At( freq ) );
+			if ( fv < 0 ) {
+				XMLERR( e, "Frequency value cannot be negative " << r );
 			}
 			rp->mRows.at(i).Erase( freq );
-			rp->mFreqs.push_back( fv );
+			weights.push_back( fv );
 			sum += fv;
 		}
-		if ( sum != 100 ) {
-			XMLERR( e, "Frequencies must sum to 100%" );
+		if ( sum <= 0 ) {
+			XMLERR( e, "Frequencies must not all be zero" );
 		}
+		rp->mFreqs.Build( weights );
 	}
 
 	return rp.release();
@@ -299,6 +301,29 @@ DEFTEST( FromXML3 ) {
 	FAILNE( r.At(0), "bar" );
 }
 
+// frequencies are any non-negative weights, not all zero
+DEFTEST( Freq ) {
+	XMLPtr xp( "<rows values='2.5,0' random='yes' freq='1' />" );
+	DSRows * dsr = (DSRows *) DSRows::FromXML( xp );
+	FAILNE( dsr->Size(), 2 );
+	FAILNE( dsr->Get().Size(), 0 );
+	const char * bad[] = {
+		"<rows values='2.5,-1' random='yes' freq='1' />",
+		"<rows values='0,0' random='yes' freq='1' />",
+		0
+	};
+	for ( unsigned int i = 0; bad[i]; i++ ) {
+		bool ok = false;
+		try {
+			XMLPtr bp( bad[i] );
+			DSRows::FromXML( bp );
+		}
+		catch( const XMLError & ) {
+			ok = true;
+		}
+		FAILNE( ok, true );
+	}
+}
 
 #endif
 
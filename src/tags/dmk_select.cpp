@@ -83,7 +83,7 @@ DSSelect :: DSSelect( const FieldList & order )
 
 //----------------------------------------------------------------------------
 // Get row from first source then compare with cases until one matches and
-// get row from that. Return concatenation of the two rows
+// have that add its values. Return concatenation of the two rows
 //----------------------------------------------------------------------------
 
 Row DSSelect  :: Get() {
@@ -91,7 +91,8 @@ Row DSSelect  :: Get() {
 	for ( unsigned int i = 1; i < SourceCount(); i++ ) {
 		DSCase * cs = dynamic_cast <DSCase *>( SourceAt(i) );
 		if ( cs->Match( r ) ) {
-			return Order( r.AppendRow( cs->Get() ) );
+			cs->Emit( r );
+			return Order( r );
 		}
 	}
 	throw Exception( "No default case" );
@@ -14,6 +14,7 @@
 #include "dmk_xmlutil.h"
 #include "dmk_strings.h"
 #include "dmk_random.h"
+#include "dmk_types.h"
 
 using std::string;
 using std::vector;
@@ -24,9 +25,15 @@ namespace DMK {
 
 const char * const SHUFFLE_TAG 		= "shuffle";
 
+//----------------------------------------------------------------------------
+// If all the children are sequences, nothing is stored - each cycle of the
+// shuffle deals the children's values in the order given by a keyed
+// permutation of their indexes, with a new key for each cycle. A shuffle
+// like this is itself a sequence. Otherwise the rows are read in and
+// dealt out like a deck of cards.
 //----------------------------------------------------------------------------
 
-class DSShuffle : public CompositeDataSource {
+class DSShuffle : public CompositeDataSource, public SequenceType {
 
 	public:
 
@@ -36,12 +43,27 @@ class DSShuffle : public CompositeDataSource {
 		int Size();
 		void Discard();
 		Row Get();
+		void Emit( Row & row );
+
+		bool Indexable() const;
+		bool DistinctText() const;
+		void EmitAt( Row & row, unsigned long long i );
 
 	private:
 
 		void Populate();
+		const std::vector <SequenceType *> & Sequences() const;
+		void EmitChildrenAt( Row & row, unsigned long long i );
+		unsigned long long CycleIndex( unsigned long long i );
+
 		Rows mRows;
 		int mEnd;
+		mutable std::vector <SequenceType *> mSeqs;
+		mutable bool mHaveSeqs;
+		unsigned long long mPos;			// next index if indexable
+		bool mHaveKey;
+		unsigned long long mKey;
+		Permutation mPerm;					// for the first cycle
 };
 
 //----------------------------------------------------------------------------
@@ -55,14 +77,51 @@ static RegisterDS <DSShuffle> regrs1_( SHUFFLE_TAG );
 //----------------------------------------------------------------------------
 
 DSShuffle :: DSShuffle( const FieldList & order  )
-	: CompositeDataSource( order ) , mEnd(0) {
+	: CompositeDataSource( order ) , mEnd(0), mHaveSeqs( false ), mPos( 0 ),
+		mHaveKey( false ), mKey( 0 ) {
+}
+
+//----------------------------------------------------------------------------
+// Our children as sequences, which is empty unless they all are. Worked
+// out once, as the children don't change once we are in use.
+//----------------------------------------------------------------------------
+
+const std::vector <SequenceType *> & DSShuffle :: Sequences() const {
+	if ( ! mHaveSeqs ) {
+		for ( unsigned int i = 0; i < SourceCount(); i++ ) {
+			SequenceType * seq = AsSequence( SourceAt( i ) );
+			if ( seq == 0 ) {
+				mSeqs.clear();
+				break;
+			}
+			mSeqs.push_back( seq );
+		}
+		mHaveSeqs = true;
+	}
+	return mSeqs;
+}
+
+bool DSShuffle :: Indexable() const {
+	return ! Sequences().empty();
+}
+
+bool DSShuffle :: DistinctText() const {
+	for ( unsigned int i = 0; i < Sequences().size(); i++ ) {
+		if ( ! Sequences()[i]->DistinctText() ) {
+			return false;
+		}
+	}
+	return true;
 }
 
 //----------------------------------------------------------------------------
-// We can support size only after population
+// We can support size only after population, unless indexable
 //----------------------------------------------------------------------------
 
 int DSShuffle :: Size() {
+	if ( Indexable() ) {
+		return CompositeDataSource::Size();
+	}
 	Populate();
 	return mRows.size();
 }
@@ -98,22 +157,80 @@ void DSShuffle :: Populate() {
 	mEnd = 0;
 }
 
+//----------------------------------------------------------------------------
+// Where output position i of an indexable shuffle comes from. The key is
+// drawn from our stream when first needed and varied for each cycle. Only
+// the first cycle's permutation is kept, so once the key has been drawn
+// this changes nothing, and rows can be made on several threads at once.
+//----------------------------------------------------------------------------
+
+unsigned long long DSShuffle :: CycleIndex( unsigned long long i ) {
+	if ( ! mHaveKey ) {
+		mKey = (unsigned long long) Rand()() << 32;
+		mKey |= Rand()();
+		mHaveKey = true;
+		mPerm = Permutation( CompositeDataSource::Size(), mKey );
+	}
+	unsigned long long n = mPerm.Size(), cycle = i / n;
+	if ( cycle == 0 ) {
+		return mPerm.At( i );
+	}
+	Permutation p( n, mKey + cycle * 0x9E3779B97F4A7C15ULL );
+	return p.At( i % n );
+}
+
+//----------------------------------------------------------------------------
+// Row i of an indexable shuffle
+//----------------------------------------------------------------------------
+
+void DSShuffle :: EmitChildrenAt( Row & row, unsigned long long i ) {
+	const std::vector <SequenceType *> & seqs = Sequences();
+	for ( unsigned int k = 0; k < seqs.size(); k++ ) {
+		seqs[k]->EmitAt( row, i );
+	}
+}
+
+void DSShuffle :: EmitAt( Row & row, unsigned long long i ) {
+	unsigned long long j = CycleIndex( i );
+	if ( Ordered() ) {
+		Row r;
+		EmitChildrenAt( r, j );
+		row.AppendRow( Order( r ) );
+	}
+	else {
+		EmitChildrenAt( row, j );
+	}
+}
+
 //----------------------------------------------------------------------------
 // Deal out shuffled row by picking random value from set of values. Then
 // remove it from the set and reduce set size by one.
 //----------------------------------------------------------------------------
 
 Row DSShuffle :: Get() {
+	if ( Indexable() ) {
+		Row r;
+		EmitAt( r, mPos++ );
+		return r;
+	}
 	Populate();
 	if ( mEnd == 0 ) {
 		mEnd = mRows.size();
 	}
-	int i = RNG::Random( 0, mEnd-- );
+	int i = Rand().Random( 0, mEnd-- );
 	Row r = mRows[i];
 	mRows[i] = mRows[mEnd];
 	return Order(r);
 }
 
+void DSShuffle :: Emit( Row & row ) {
+	if ( Indexable() ) {
+		EmitAt( row, mPos++ );
+	}
+	else {
+		row.AppendRef( Get() );
+	}
+}
 
 //----------------------------------------------------------------------------
 // create from xml
@@ -153,6 +270,36 @@ DEFTEST( Simple ) {
 	FAILNE( r.Size(), 1 );
 }
 
+const char * const XML2 =
+	"<shuffle>\n"
+		"<int_seq begin='1' end='1000' />\n"
+		"<time_seq begin='00:00:00' end='00:01:39' />\n"
+	"</shuffle>\n";
+
+// sequences are shuffled by index, each cycle dealing every row once
+DEFTEST( Indexed ) {
+	XMLPtr xml( XML2 );
+	DSShuffle * p = (DSShuffle *) DSShuffle::FromXML( xml );
+	FAILNE( p->Indexable(), true );
+	FAILNE( p->Size(), 1000 );
+	for ( int c = 0; c < 2; c++ ) {
+		std::vector <int> seen( 1000 );
+		unsigned int inorder = 0;
+		for ( int i = 0; i < 1000; i++ ) {
+			Row r = p->Get();
+			int n = ALib::ToInteger( r.At( 0 ) );
+			FAILEQ( n < 1 || n > 1000, true );
+			FAILNE( seen[n - 1]++, 0 );
+			FAILNE( r.Type( 1 ), CELL_TIME );
+			Row t;
+			FAILNE( r.At( 1 ), t.AppendTime( (n - 1) % 100 ).At( 0 ) );
+			inorder += n == i + 1;
+		}
+		FAILEQ( inorder > 10, true );
+	}
+	delete p;
+}
+
 
 #endif
 
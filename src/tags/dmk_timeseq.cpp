@@ -18,6 +18,7 @@
 
 #include <sstream>
 #include <iomanip>
+#include <cmath>
 
 using std::string;
 using std::vector;
@@ -55,19 +56,23 @@ class TimeRep {
 // Time Sequence
 //----------------------------------------------------------------------------
 
-class TimeSeq : public DataSource, public SequenceType {
+class TimeSeq : public LeafSource, public SequenceType {
 
 	public:
 
 		TimeSeq( const FieldList & order,	const TimeRep & begin,
 							const TimeRep & end, int inc );
 
-		Row Get();
 		int Size();
 		void Reset();
+		void EmitAt( Row & row, unsigned long long i );
 
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
+	protected:
+
+		void EmitCells( Row & row );
+
 	private:
 
 		TimeRep mBegin, mEnd, mNow;
@@ -78,7 +83,7 @@ class TimeSeq : public DataSource, public SequenceType {
 // Random times
 //----------------------------------------------------------------------------
 
-class RandTime : public DataSource {
+class RandTime : public LeafSource {
 
 	public:
 
@@ -86,19 +91,29 @@ class RandTime : public DataSource {
 						const TimeRep &  end );
 		RandTime( const FieldList & order,	const TimeRep &  begin,
 						const TimeRep &  end, const TimeRep &  mode );
+		RandTime( const FieldList & order, const DistSpec & ds );
 
 		~RandTime();
 
-		Row Get();
 		int Size();
         void Reset() {} 	// does nothing
 
 		static DataSource * FromXML( const ALib::XMLElement * e );
 
+	protected:
+
+		void EmitCells( Row & row );
+		void EmitCellBatch( Rows & rows, unsigned int n );
+
 	private:
 
+		int Secs( double d ) const;
+
 		TimeRep mBegin;
 		Distribution * mDist;
+		bool mRound;
+		std::vector <int> mSecs;
+		std::vector <double> mReals;
 };
 
 //----------------------------------------------------------------------------
@@ -194,13 +209,12 @@ TimeSeq :: TimeSeq( const FieldList & order, const TimeRep & begin,
 // Get next in range, wrapping at end
 //----------------------------------------------------------------------------
 
-Row TimeSeq :: Get() {
-	string s = mNow.Str();
+void TimeSeq :: EmitCells( Row & row ) {
+	row.AppendTime( mNow.AsInt() );
 	mNow.Inc( mInc );
 	if ( mNow.AsInt() > mEnd.AsInt() ) {
 		mNow = mBegin;
 	}
-	return Order( Row( s ) );
 }
 
 //----------------------------------------------------------------------------
@@ -211,6 +225,14 @@ int TimeSeq :: Size() {
 	return 1 + (mEnd.AsInt() - mBegin.AsInt()) / mInc;
 }
 
+//----------------------------------------------------------------------------
+// Time i of the cycle
+//----------------------------------------------------------------------------
+
+void TimeSeq :: EmitAt( Row & row, unsigned long long i ) {
+	row.AppendTime( mBegin.AsInt() + int( i % Size() ) * mInc );
+}
+
 //----------------------------------------------------------------------------
 // Reset to start of range
 //----------------------------------------------------------------------------
@@ -256,13 +278,13 @@ DataSource * TimeSeq :: FromXML( const ALib::XMLElement * e ) {
 
 RandTime :: RandTime( const FieldList & order,	const TimeRep & begin,
 								const TimeRep &  end )
-	: DataSource( order ), mBegin( begin ), mDist( 0 ) {
+	: LeafSource( order ), mBegin( begin ), mDist( 0 ), mRound( false ) {
 
 	if ( begin.AsInt() == end.AsInt() ) {
-		mDist = new UniformDist( 0, 24 * 60 * 60 - 1  );
+		mDist = new UniformDist( Rand(), 0, 24 * 60 * 60 - 1  );
 	}
 	else {
-		mDist = new UniformDist( 0, end.AsInt() - begin.AsInt() );
+		mDist = new UniformDist( Rand(), 0, end.AsInt() - begin.AsInt() );
 	}
 }
 
@@ -272,16 +294,36 @@ RandTime :: RandTime( const FieldList & order,	const TimeRep & begin,
 
 RandTime :: RandTime( const FieldList & order,	const TimeRep &  begin,
 				const TimeRep &  end, const TimeRep &  mode )
-	: DataSource( order ), mBegin( begin ), mDist( 0 ) {
+	: LeafSource( order ), mBegin( begin ), mDist( 0 ), mRound( false ) {
 
 	if ( begin.AsInt() == end.AsInt() ) {
-		mDist = new TriangleDist( 0, mode.AsInt(), 24 * 60 * 60 - 1  );
+		mDist = new TriangleDist( Rand(), 0, mode.AsInt(), 24 * 60 * 60 - 1  );
 	}
 	else {
-		mDist = new TriangleDist( begin.AsInt(), mode.AsInt(), end.AsInt() );
+		mDist = new TriangleDist( Rand(), begin.AsInt(), mode.AsInt(), end.AsInt() );
 	}
 }
 
+//----------------------------------------------------------------------------
+// Random time from named distribution of seconds after midnight
+//----------------------------------------------------------------------------
+
+RandTime :: RandTime( const FieldList & order, const DistSpec & ds )
+	: LeafSource( order ), mDist( ds.Make( Rand() ) ), mRound( true ) {
+}
+
+//----------------------------------------------------------------------------
+// Named distributions can give any number of seconds - round to the
+// nearest and wrap them into the day
+//----------------------------------------------------------------------------
+
+int RandTime :: Secs( double d ) const {
+	const double day = 24 * 60 * 60;
+	d = std::floor( d + 0.5 );
+	d -= std::floor( d / day ) * day;
+	return d >= 0 && d < day ? int( d ) : 0;
+}
+
 //----------------------------------------------------------------------------
 // Junk distribution
 //----------------------------------------------------------------------------
@@ -291,14 +333,40 @@ RandTime :: ~RandTime() {
 }
 
 //----------------------------------------------------------------------------
-// Get random int & transform into time rep
+// Get random int & transform into time, which the row stores natively
 //----------------------------------------------------------------------------
 
-Row RandTime :: Get() {
+void RandTime :: EmitCells( Row & row ) {
+	if ( mRound ) {
+		row.AppendTime( Secs( mDist->NextReal() ) );
+		return;
+	}
 	int n = mDist->NextInt();
 	TimeRep t = mBegin;
 	t.Inc( n );
-	return Order( Row( t.Str() ) );
+	row.AppendTime( t.AsInt() );
+}
+
+//----------------------------------------------------------------------------
+// Block of random times - second offsets are made in one go
+//----------------------------------------------------------------------------
+
+void RandTime :: EmitCellBatch( Rows & rows, unsigned int n ) {
+	if ( mRound ) {
+		mReals.resize( n );
+		mDist->FillReal( &mReals[0], n );
+		for ( unsigned int i = 0; i < n; i++ ) {
+			rows[i].AppendTime( Secs( mReals[i] ) );
+		}
+		return;
+	}
+	mSecs.resize( n );
+	mDist->FillInt( &mSecs[0], n );
+	for ( unsigned int i = 0; i < n; i++ ) {
+		TimeRep t = mBegin;
+		t.Inc( mSecs[i] );
+		rows[i].AppendTime( t.AsInt() );
+	}
 }
 
 //----------------------------------------------------------------------------
@@ -316,7 +384,12 @@ int RandTime :: Size() {
 DataSource * RandTime :: FromXML( const ALib::XMLElement * e ) {
 	ForbidChildren( e );
 	AllowAttrs( e, AttrList( BEGIN_ATTRIB, END_ATTRIB, MODE_ATTR,
-								ORDER_ATTRIB, 0 ));
+								ORDER_ATTRIB, DIST_ATTRIB, MEAN_ATTRIB,
+								SD_ATTRIB, 0 ));
+	DistSpec ds = GetDistSpec( e );
+	if ( ! ds.Empty() ) {
+		return new RandTime( GetOrder( e ), ds );
+	}
 	bool havemode = false;
 	TimeRep begin, end, mode;
 	try {
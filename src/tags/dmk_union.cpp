@@ -13,6 +13,7 @@
 #include "dmk_tagdict.h"
 #include "dmk_xmlutil.h"
 #include "dmk_strings.h"
+#include "dmk_rowhash.h"
 
 using std::string;
 using std::vector;
@@ -35,8 +36,7 @@ class DSUnion : public Intermediate {
 
 	private:
 
-		void AddToUnion( DataSource * s );
-		bool AlreadyHave( const Row & r ) const;
+		void AddToUnion( DataSource * s, RowHashSet & have );
 };
 
 //----------------------------------------------------------------------------
@@ -51,36 +51,26 @@ DSUnion :: DSUnion( const FieldList & order, bool rand  )
 }
 
 
-// does this row already exist in union?
-// TODO (neilb#1#): change to use map  as index
-bool DSUnion :: AlreadyHave( const Row & r ) const {
-	for ( unsigned int i = 0; i < ResultRows().size(); i++ ) {
-		if ( r == ResultRows().at( i ) ) {
-			return true;
-		}
-	}
-	return false;
-}
-
 // add row to union only if not already there
-// this is currently extremely inefficient!
-void DSUnion :: AddToUnion( DataSource * s ) {
+void DSUnion :: AddToUnion( DataSource * s, RowHashSet & have ) {
 	int n = s->Size();
 	while( n-- ) {
 		Row r = s->Get();
-		if ( ! AlreadyHave( r ) ) {
+		if ( have.Insert( r ) ) {
 			AddRow( r );	// add to rows held by base
 		}
 	}
 }
 
-// build the union from the data sources
+// build the union from the data sources - rows already in the union are
+// found with a hash index over them, which is only needed while building
 void DSUnion :: Populate() {
+	RowHashSet have( ResultRows() );
 	for ( unsigned int i = 0; i < SourceCount(); i++ ) {
 		if ( SourceAt( i )->Size() <= 0 ) {
 			throw Exception( "source " + ALib::Str(i+1) + " has no size" );
 		}
-		AddToUnion( SourceAt(i) );
+		AddToUnion( SourceAt(i), have );
 	}
 }
 
@@ -134,6 +124,40 @@ DEFTEST( Simple ) {
 
 }
 
+const char * const XML2 =
+	"<union random='no'>\n"
+		"<int_seq begin='1' end='1000' />\n"
+		"<int_seq begin='500' end='1500' />\n"
+		"<int_seq begin='1' end='1500' />\n"
+	"</union>\n";
+
+// overlapping sequences keep the first of each value, in order
+DEFTEST( Overlap ) {
+	XMLPtr xml( XML2 );
+	DSUnion * p = (DSUnion *) DSUnion::FromXML( xml );
+	FAILNE( p->Size(), 1500 );
+	for ( int i = 1; i <= 1500; i++ ) {
+		FAILNE( p->Get().At( 0 ), ALib::Str( i ) );
+	}
+	delete p;
+}
+
+const char * const XML3 =
+	"<union random='no'>\n"
+		"<row values='7' />\n"
+		"<int_seq begin='7' end='8' />\n"
+	"</union>\n";
+
+// a text field and an int field with the same text are the same value
+DEFTEST( TextInt ) {
+	XMLPtr xml( XML3 );
+	DSUnion * p = (DSUnion *) DSUnion::FromXML( xml );
+	FAILNE( p->Size(), 2 );
+	FAILNE( p->Get().At( 0 ), "7" );
+	FAILNE( p->Get().At( 0 ), "8" );
+	delete p;
+}
+
 
 #endif
 
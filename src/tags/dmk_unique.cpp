@@ -13,7 +13,8 @@
 #include "dmk_tagdict.h"
 #include "dmk_xmlutil.h"
 #include "dmk_strings.h"
-#include <set>
+#include "dmk_rowhash.h"
+#include "dmk_types.h"
 
 using std::string;
 using std::vector;
@@ -24,28 +25,27 @@ namespace DMK {
 
 const char * const UNIQUE_TAG 			= "unique";
 const char * const RETRY_ATTRIB 		= "retry";
+const char * const VERIFY_ATTRIB 		= "verify";
 const int UNIQUE_RETRY 				= 100;		// retry count
 
+//----------------------------------------------------------------------------
+// Rows already produced are remembered by hash only, unless verify is
+// set, in which case the rows are kept too and compared on a hash match.
+// Whole rows from sequences (including shuffled ones) are all different
+// within a cycle, so need no remembering or retrying.
 //----------------------------------------------------------------------------
 
 class DSUnique : public CompositeDataSource {
 
 	public:
 
-		// do comparisons of two fields taking field list into account
-		struct CmpRows {
-			CmpRows( const FieldList & fl ) : mFields( fl ) {}
-			bool operator()( const Row & r1, const Row & r2 ) const {
-				bool n = Cmp( r1, r2, mFields ) < 0;
-				return n;
-			}
-			FieldList mFields;
-		};
-
-		DSUnique( const FieldList & order, const FieldList & cmpf, int retry );
+		DSUnique( const FieldList & order, const FieldList & cmpf,
+					int retry, bool verify );
 
 		int Size();
 		Row Get();
+		void Emit( Row & row );
+		void EmitBatch( Rows & rows, unsigned int n );
 
 		void Discard();
 
@@ -53,10 +53,16 @@ class DSUnique : public CompositeDataSource {
 
 	private:
 
-		typedef std::set <Row,CmpRows> SetType;
-		SetType mUniqueRows;
+		bool Distinct();
+		void CountDistinct( unsigned int n );
+
+		RowHashSet mUniqueRows;
 		vector <Row> mRows;
 		int mPos, mRetry;
+		bool mAllFields;
+		int mDistinct;				// -1 until worked out
+		int mCycle;					// size of distinct children's cycle
+		int mCount;					// rows got from distinct children
 };
 
 //----------------------------------------------------------------------------
@@ -65,15 +71,49 @@ static RegisterDS <DSUnique> regrs1_( UNIQUE_TAG );
 
 DSUnique :: DSUnique( const FieldList & order,
 						const FieldList & cmpfields,
-						int retry )
+						int retry, bool verify )
 	: CompositeDataSource( order ),
-		mUniqueRows( cmpfields ), mPos( -1 ), mRetry( retry + 1) {
+		mUniqueRows( cmpfields, verify ), mPos( -1 ), mRetry( retry + 1),
+		mAllFields( cmpfields.Size() == 0 ), mDistinct( -1 ),
+		mCycle( 0 ), mCount( 0 ) {
+}
+
+// are the rows we get bound to be different for a whole cycle, once
+// formatted? the children are fixed by the time we are asked, so this is
+// worked out once
+bool DSUnique :: Distinct() {
+	if ( mDistinct < 0 ) {
+		mDistinct = mAllFields && SourceCount() > 0;
+		for ( unsigned int i = 0; mDistinct && i < SourceCount(); i++ ) {
+			SequenceType * seq = AsSequence( SourceAt( i ) );
+			mDistinct = seq != 0 && seq->DistinctText();
+		}
+		if ( mDistinct ) {
+			mCycle = CompositeDataSource::Size();
+		}
+	}
+	return mDistinct;
+}
+
+// if no size was asked for, rows past the first cycle would repeat
+void DSUnique :: CountDistinct( unsigned int n ) {
+	if ( mPos < 0 ) {
+		if ( n > (unsigned int) (mCycle - mCount) ) {
+			throw Exception( "cannot find enough unique values" );
+		}
+		mCount += n;
+	}
 }
 
 // if we receive size message read rows from kids discarding dupes
 // and use those rows to fufill future requests
 int DSUnique :: Size() {
 
+	if ( Distinct() ) {
+		mPos = 0;
+		return mCycle;
+	}
+
 	if ( mPos >= 0 ) {			// already have size
 		return mRows.size();
 	}
@@ -81,8 +121,7 @@ int DSUnique :: Size() {
 	int n = CompositeDataSource::Size();
 	while( n-- ) {
 		Row r = CompositeDataSource::Get();
-		if ( mUniqueRows.find( r ) == mUniqueRows.end() ) {
-			mUniqueRows.insert( r );
+		if ( mUniqueRows.Insert( r ) ) {
 			mRows.push_back( r );
 		}
 	}
@@ -98,7 +137,11 @@ int DSUnique :: Size() {
 // size message, return one of those rows. otherwise try to
 // get a unique row anf fail noisily if that seems not possible
 Row DSUnique :: Get() {
-	if ( mPos >= 0 ) {
+	if ( Distinct() ) {
+		CountDistinct( 1 );
+		return CompositeDataSource::Get();
+	}
+	else if ( mPos >= 0 ) {
 		Row r = mRows[ mPos++];
 		mPos %= mRows.size();
 		return Order( r );
@@ -107,8 +150,7 @@ Row DSUnique :: Get() {
 		int n = mRetry;
 		while( n-- ) {
 			Row r = CompositeDataSource::Get();
-			if ( mUniqueRows.find( r ) == mUniqueRows.end() ) {
-				mUniqueRows.insert( r );
+			if ( mUniqueRows.Insert( r ) ) {
 				return Order( r );
 			}
 		}
@@ -116,6 +158,27 @@ Row DSUnique :: Get() {
 	}
 }
 
+// rows from distinct children go straight into the caller's rows
+void DSUnique :: Emit( Row & row ) {
+	if ( Distinct() && ! Ordered() ) {
+		CountDistinct( 1 );
+		EmitChildren( row );
+	}
+	else {
+		DataSource::Emit( row );
+	}
+}
+
+void DSUnique :: EmitBatch( Rows & rows, unsigned int n ) {
+	if ( Distinct() ) {
+		CountDistinct( n );
+		EmitChildBatch( rows, n );
+	}
+	else {
+		DataSource::EmitBatch( rows, n );
+	}
+}
+
 // discard needs to chuck away saved rows
 void DSUnique :: Discard() {
 	mRows.clear();
@@ -125,10 +188,13 @@ void DSUnique :: Discard() {
 //	order	- usual stuff
 //	fields	- list of fields to consider for uniqueness
 //	retry	- number of time sto retry getting unique row
+//	verify	- compare rows with the same hash, rather than assuming
+//			  they are the same
 DataSource * DSUnique :: FromXML( const ALib::XMLElement * e ) {
 
 	RequireChildren( e );
-	AllowAttrs( e, AttrList( ORDER_ATTRIB,FIELDS_ATTRIB, RETRY_ATTRIB, 0 ) );
+	AllowAttrs( e, AttrList( ORDER_ATTRIB,FIELDS_ATTRIB, RETRY_ATTRIB,
+								VERIFY_ATTRIB, 0 ) );
 
 	string fl = e->AttrValue( FIELDS_ATTRIB, "" );
 	FieldList cmpf( fl );
@@ -137,7 +203,10 @@ DataSource * DSUnique :: FromXML( const ALib::XMLElement * e ) {
 		throw XMLError( ALib::SQuote( RETRY_ATTRIB ) + " cannot be negative", e );
 	}
 
-	std::auto_ptr <DSUnique> c( new DSUnique( GetOrder( e ), cmpf , retry ));
+	bool verify = GetBool( e, VERIFY_ATTRIB, NO_STR );
+
+	std::auto_ptr <DSUnique> c( new DSUnique( GetOrder( e ), cmpf,
+												retry, verify ));
 
 	c->AddChildSources( e );
 	return c.release();
@@ -153,6 +222,7 @@ DataSource * DSUnique :: FromXML( const ALib::XMLElement * e ) {
 #ifdef DMK_TEST
 
 #include "a_myth.h"
+#include <algorithm>
 using namespace ALib;
 using namespace DMK;
 
@@ -172,6 +242,100 @@ DEFTEST( Simple ) {
 	FAILNE( r.At(1), "2" );
 }
 
+const char * const XML2 =
+	"<unique fields='1' verify='yes'>\n"
+		"<int_seq begin='1' end='3' />\n"
+		"<rand_int begin='1' end='100' />\n"
+	"</unique>\n";
+
+// duplicates on the compared field are dropped from the sized rows
+DEFTEST( Sized ) {
+	XMLPtr xml( XML2 );
+	DSUnique * p = (DSUnique *) DSUnique::FromXML( xml );
+	FAILNE( p->Size(), 3 );
+	for ( int i = 0; i < 6; i++ ) {
+		FAILNE( p->Get().At( 0 ), ALib::Str( i % 3 + 1 ) );
+	}
+	delete p;
+}
+
+const char * const XML3 =
+	"<unique>\n"
+		"<shuffle>\n"
+			"<int_seq begin='1' end='500' />\n"
+		"</shuffle>\n"
+	"</unique>\n";
+
+// shuffled sequences are unique for a cycle, and no further
+DEFTEST( Sequence ) {
+	XMLPtr xml( XML3 );
+	DSUnique * p = (DSUnique *) DSUnique::FromXML( xml );
+	std::vector <int> seen( 500 );
+	for ( int i = 0; i < 500; i++ ) {
+		int n = ALib::ToInteger( p->Get().At( 0 ) );
+		FAILEQ( n < 1 || n > 500, true );
+		FAILNE( seen[n - 1]++, 0 );
+	}
+	bool thrown = false;
+	try {
+		p->Get();
+	}
+	catch( const DMK::Exception & ) {
+		thrown = true;
+	}
+	FAILNE( thrown, true );
+	delete p;
+}
+
+const char * const XML4 =
+	"<unique>\n"
+		"<pick random='no'>\n"
+			"<row values='7' />\n"
+			"<int_seq begin='7' end='8' />\n"
+		"</pick>\n"
+	"</unique>\n";
+
+// text and int fields with the same text are duplicates
+DEFTEST( TextInt ) {
+	XMLPtr xml( XML4 );
+	DSUnique * p = (DSUnique *) DSUnique::FromXML( xml );
+	std::vector <string> seen;
+	try {
+		for ( int i = 0; i < 4; i++ ) {
+			string v = p->Get().At( 0 );
+			FAILEQ( std::count( seen.begin(), seen.end(), v ), 1 );
+			seen.push_back( v );
+		}
+	}
+	catch( const DMK::Exception & ) {
+	}
+	FAILNE( (int) seen.size(), 2 );
+	delete p;
+}
+
+const char * const XML5 =
+	"<unique>\n"
+		"<real_seq begin='0' end='0.011' inc='0.001' places='2' />\n"
+	"</unique>\n";
+
+// sequence values that format the same are duplicates
+DEFTEST( Places ) {
+	XMLPtr xml( XML5 );
+	DSUnique * p = (DSUnique *) DSUnique::FromXML( xml );
+	std::vector <string> seen;
+	try {
+		for ( int i = 0; i < 12; i++ ) {
+			string v = p->Get().At( 0 );
+			FAILEQ( std::count( seen.begin(), seen.end(), v ), 1 );
+			seen.push_back( v );
+		}
+	}
+	catch( const DMK::Exception & ) {
+	}
+	FAILNE( (int) seen.size(), 2 );
+	delete p;
+}
+
 
 #endif
 
@@ -0,0 +1,243 @@
+//---------------------------------------------------------------------------
+// dmk_zipf.cpp
+//
+// Zipf (power-law) random ranks, for modelling skewed key access.
+//
+// Copyright (C) 2009 Neil Butterworth
+//---------------------------------------------------------------------------
+
+#include "a_base.h"
+#include "a_str.h"
+#include "a_collect.h"
+#include "dmk_model.h"
+#include "dmk_modman.h"
+#include "dmk_source.h"
+#include "dmk_tagdict.h"
+#include "dmk_xmlutil.h"
+#include "dmk_strings.h"
+#include "dmk_random.h"
+
+#include <cmath>
+
+using std::string;
+using std::vector;
+
+namespace DMK {
+
+//----------------------------------------------------------------------------
+
+const char * const RANDZIPF_TAG 	= "rand_zipf";
+const char * const KEYS_ATTR 		= "keys";
+const char * const EXPONENT_ATTR 	= "exponent";
+
+//----------------------------------------------------------------------------
+// Ranks from 1 to the number of keys, rank 1 being the most common. If a
+// generator is named instead, the row at that rank in the generator is
+// output, and the number of keys is the generator's size.
+//----------------------------------------------------------------------------
+
+class DSRandZipf : public LeafSource {
+
+	public:
+
+		DSRandZipf( const FieldList & order, double keys,
+						double exponent, const string & gen );
+		~DSRandZipf();
+
+		int Size();
+		void Reset() {} 	// does nothing
+
+		static DataSource * FromXML( const ALib::XMLElement * e );
+
+	protected:
+
+		void EmitCells( Row & row );
+		void EmitCellBatch( Rows & rows, unsigned int n );
+
+	private:
+
+		void MakeDist();
+		void Append( Row & row, double rank );
+
+		double mKeys, mExponent;
+		string mGenName;
+		Generator * mGen;
+		ZipfDist * mDist;
+		std::vector <double> mValues;
+};
+
+//----------------------------------------------------------------------------
+// Tag dictionary registration
+//----------------------------------------------------------------------------
+
+static RegisterDS <DSRandZipf> regrs1_( RANDZIPF_TAG );
+
+//----------------------------------------------------------------------------
+// Distribution is not made until it is used, as a generator will not have
+// any rows until then.
+//----------------------------------------------------------------------------
+
+DSRandZipf :: DSRandZipf( const FieldList & order, double keys,
+							double exponent, const string & gen )
+	: LeafSource( order ), mKeys( keys ), mExponent( exponent ),
+		mGenName( gen ), mGen( 0 ), mDist( 0 ) {
+}
+
+DSRandZipf :: ~DSRandZipf() {
+	delete mDist;
+}
+
+//----------------------------------------------------------------------------
+// Look up the generator, if there is one, and size the distribution
+//----------------------------------------------------------------------------
+
+void DSRandZipf :: MakeDist() {
+	if ( mDist ) {
+		return;
+	}
+	if ( mGenName != "" ) {
+		mGen = ModelManager::Instance()->FindGen( mGenName );
+		if ( mGen == 0 ) {
+			throw Exception( "Cannot find generator named "
+								+ ALib::SQuote( mGenName ) );
+		}
+		if ( mGen->Size() == 0 ) {
+			throw Exception( "Generator " + ALib::SQuote( mGenName )
+								+ " has no data" );
+		}
+		mKeys = mGen->Size();
+	}
+	mDist = new ZipfDist( Rand(), mKeys, mExponent );
+}
+
+//----------------------------------------------------------------------------
+// Add rank or the generator row it indexes
+//----------------------------------------------------------------------------
+
+void DSRandZipf :: Append( Row & row, double rank ) {
+	if ( mGen ) {
+		row.AppendRef( mGen->RowAt( int( rank ) - 1 ) );
+	}
+	else {
+		row.AppendInt( (long long) rank );
+	}
+}
+
+void DSRandZipf :: EmitCells( Row & row ) {
+	MakeDist();
+	Append( row, mDist->NextReal() );
+}
+
+void DSRandZipf :: EmitCellBatch( Rows & rows, unsigned int n ) {
+	MakeDist();
+	mValues.resize( n );
+	mDist->FillReal( &mValues[0], n );
+	for ( unsigned int i = 0; i < n; i++ ) {
+		Append( rows[i], mValues[i] );
+	}
+}
+
+//----------------------------------------------------------------------------
+// Random numbers cannot provide size info.
+//----------------------------------------------------------------------------
+
+int DSRandZipf :: Size() {
+	return 1;
+}
+
+//----------------------------------------------------------------------------
+// Need either the number of keys or a generator to index, but not both.
+// Keys are read as a real so that key spaces beyond the range of int
+// can be used.
+//----------------------------------------------------------------------------
+
+DataSource * DSRandZipf :: FromXML( const ALib::XMLElement * e ) {
+	ForbidChildren( e );
+	AllowAttrs( e, AttrList( KEYS_ATTR, EXPONENT_ATTR, GEN_ATTRIB,
+								ORDER_ATTRIB, 0 ));
+	if ( e->HasAttr( KEYS_ATTR ) == e->HasAttr( GEN_ATTRIB ) ) {
+		throw XMLError( "need one of " + ALib::SQuote( KEYS_ATTR )
+							+ " or " + ALib::SQuote( GEN_ATTRIB ), e );
+	}
+
+	double keys = 1;
+	if ( e->HasAttr( KEYS_ATTR ) ) {
+		keys = GetReal( e, KEYS_ATTR );
+		if ( keys < 1 || keys > 9007199254740992.0
+				|| keys != std::floor( keys ) ) {
+			throw XMLError( ALib::SQuote( KEYS_ATTR )
+								+ " must be a positive whole number", e );
+		}
+	}
+
+	double exponent = GetReal( e, EXPONENT_ATTR, "1" );
+	if ( exponent <= 0 ) {
+		throw XMLError( ALib::SQuote( EXPONENT_ATTR )
+							+ " must be greater than zero", e );
+	}
+
+	string gen = e->AttrValue( GEN_ATTRIB, "" );
+	if ( gen != "" ) {
+		ModelManager::Instance()->AddGenRef( gen );
+	}
+	return new DSRandZipf( GetOrder( e ), keys, exponent, gen );
+}
+
+//----------------------------------------------------------------------------
+
+} // namespace
+
+//----------------------------------------------------------------------------
+
+#ifdef DMK_TEST
+
+#include "a_myth.h"
+using namespace ALib;
+using namespace DMK;
+
+DEFSUITE( "Zipf" );
+
+DEFTEST( FromXML ) {
+	string xml = "<rand_zipf keys='5000000000' exponent='1.1'/>";
+	XMLPtr xp( xml );
+	DSRandZipf * z = (DSRandZipf *) DSRandZipf::FromXML( xp );
+	Rows rows;
+	z->GetBatch( rows, 100 );
+	int ones = 0;
+	for ( unsigned int i = 0; i < rows.size(); i++ ) {
+		FAILNE( rows[i].Size(), 1 );
+		double k = ALib::ToReal( rows[i].At(0) );
+		FAILEQ( k < 1 || k > 5000000000.0, true );
+		ones += k == 1;
+	}
+	FAILEQ( ones == 0, true );
+	delete z;
+}
+
+DEFTEST( BadXML ) {
+	const char * bad[] = {
+		"<rand_zipf />",
+		"<rand_zipf keys='10' gen='foo' />",
+		"<rand_zipf keys='0' />",
+		"<rand_zipf keys='10.5' />",
+		"<rand_zipf keys='10' exponent='0' />",
+		0
+	};
+	for ( unsigned int i = 0; bad[i]; i++ ) {
+		bool ok = false;
+		try {
+			XMLPtr xp( bad[i] );
+			DSRandZipf::FromXML( xp );
+		}
+		catch( const XMLError & ) {
+			ok = true;
+		}
+		FAILNE( ok, true );
+	}
+}
+
+#endif
+
+//----------------------------------------------------------------------------
+
+// end